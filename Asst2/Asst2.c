@@ -5,716 +5,7363 @@
 #include <pthread.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
 #include <ctype.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <math.h>
+#include <time.h>
+#include <errno.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#define HAVE_IO_URING 1
+#endif
+#endif
+
+// Directories this many levels below the base directory or less get a thread of their own
+// Deeper ones are read by the thread of the directory above them
+
+#define WALK_THREAD_DEPTH 3
+
+// Size of the buffer every directory is read into with getdents64()
+
+#define WALK_BUFFER 65536
+
+// Size of the blocks a file is read back in to make sure it is the same as an earlier one, see sameContents()
+
+#define DEDUP_BLOCK 65536
+
+// Number of threads that read and tokenize files with blocking reads, enough to keep a disk busy
+
+#define INGEST_READERS 16
+
+// Number of files the directory walk may queue ahead of the reading threads
+
+#define INGEST_QUEUE 1024
+
+// Number of tokenized files that may wait for the vocabulary merge
+
+#define MERGE_QUEUE 256
+
+// Number of file reads the io_uring ring keeps in flight, and files read but not yet tokenized
+
+#define RING_DEPTH 64
+
+// Character classes of the tokenizer's table, see selectKernel()
+
+#define CLASS_SPACE 1
+#define CLASS_WORD 2
+
+// Longest shingle of words that --ngram can make into a single feature
+
+#define NGRAM_MAX 16
+
+// Distances that --metric can compare files with, see finishMean()
+
+#define METRIC_JSD 0
+#define METRIC_COSINE 1
+#define METRIC_JACCARD 2
+#define METRIC_HELLINGER 3
+
+// Number of files on each side of a square tile of the pair matrix handed to one analysis thread
+
+#define TILE_SIZE 32
+
+// Number of shared words handed to the pair kernel at once
+
+#define KERNEL_BLOCK 64
+
+// MinHash signatures for --topk are LSH_BANDS bands of LSH_ROWS hashes each
+// Files that agree on every hash of at least one band become candidate pairs
+
+#define LSH_BANDS 20
+#define LSH_ROWS 3
+#define LSH_HASHES (LSH_BANDS * LSH_ROWS)
+
+// Largest group of colliding files paired all with all, bigger groups only pair near neighbours
+
+#define LSH_MAX_BUCKET 256
+
+// Number of pairs under the --threshold that a worker holds before printing them
+
+#define STREAM_BUFFER 256
+
+// First bytes of a --cache file, followed by the format version, which also changes with the tokenizer
+
+#define CACHE_MAGIC "DTC1"
+#define CACHE_VERSION 4
+
+// First bytes of a --store file, followed by the format version, which also changes with the tokenizer
+
+#define STORE_MAGIC "DTS1"
+#define STORE_VERSION 5
+
+// First bytes of a --snapshot file, followed by the format version
+
+#define SNAPSHOT_MAGIC "DTP1"
+#define SNAPSHOT_VERSION 1
+
+// Largest number of phases --stats keeps track of
+
+#define STATS_PHASES 16
 
 struct wordNode
 {
     char *word;
     float occurrence;
-    struct wordNode *next;
+    int id;
+};
+
+struct wordTable
+{
+    char *text;
+    size_t textLength;
+    size_t textCapacity;
+    size_t *offsets;
+    float *counts;
+    int numWords;
+    int capacity;
+    int *slots;
+    long numSlots;
+};
+
+struct kernelBlock
+{
+    double prob1[KERNEL_BLOCK];
+    double prob2[KERNEL_BLOCK];
+    double weight1[KERNEL_BLOCK];
+    double weight2[KERNEL_BLOCK];
+    int slot[KERNEL_BLOCK];
+    int n;
+};
+
+struct invertedIndex
+{
+    long numPostings;
+    long *start;
+    int *file;
+    double *prob;
+    double *weight;
 };
 
 struct meanNode
 {
     char *fileName1;
     char *fileName2;
+    int index1;
+    int index2;
     int total;
     float KLD1;
     float KLD2;
     float JSD;
-    struct meanNode *next;
+};
+
+struct spillRecord
+{
+    int total;
+    int index1;
+    int index2;
+    float JSD;
+};
+
+struct spillRuns
+{
+    int fd;
+    long numRecords;
+    long *runStart;
+    long numRuns;
+    long capacity;
+    struct fileNode **files;
+};
+
+struct fileList
+{
+    struct fileNode *head;
+    struct fileNode *tail;
+};
+
+struct dirWait
+{
+    int pending;
+    pthread_mutex_t lock;
+    pthread_cond_t done;
+};
+
+struct ingestQueue
+{
+    struct fileNode *head;
+    struct fileNode *tail;
+    long size;
+    long capacity;
+    bool closed;
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+};
+
+struct ringRead
+{
+    struct fileNode *filePtr;
+    int fd;
+    size_t offset;
+};
+
+struct ingestEngine
+{
+    struct ingestQueue files;
+    struct ingestQueue buffers;
+    struct ingestQueue merged;
+    pthread_t *threads;
+    double *cpuTimes;
+    int numThreads;
+    bool ring;
+    pthread_t ringId;
+    double ringCpuTime;
+    pthread_t mergeId;
+    double mergeCpuTime;
+    int *mergeTable;
+    long mergeTableSize;
+    struct fileNode **dedupTable;
+    long dedupTableSize;
+    long dedupCount;
+    pthread_mutex_t dedupLock;
+    int ringFd;
+    unsigned char *sqRing;
+    size_t sqLength;
+    unsigned char *cqRing;
+    size_t cqLength;
+    void *sqes;
+    size_t sqesLength;
+    unsigned *sqTail;
+    unsigned *sqMask;
+    unsigned *sqArray;
+    unsigned *cqHead;
+    unsigned *cqTail;
+    unsigned *cqMask;
+    void *cqes;
 };
 
 struct fileNode
 {
     pthread_t id;
+    bool threaded;
     char *fileName;
+    int nameOffset;
+    int dirFd;
+    int depth;
     bool folder;
     int total;
-    struct wordNode *wordHead;
+    struct args *argsParam;
+    bool statted;
+    uint64_t inode;
+    uint64_t size;
+    int64_t mtimeSec;
+    int64_t mtimeNsec;
+    struct fileList children;
+    char *words;
+    int *ids;
+    float *counts;
+    uint64_t *features;
+    long wordStart;
+    int numWords;
+    bool cached;
+    double cpuTime;
+    struct dirWait *wait;
+    struct cacheEntry *entry;
+    uint64_t contentHash;
+    struct fileNode *original;
+    int group;
+    char *data;
+    size_t length;
+    struct fileNode *queueNext;
     struct fileNode *next;
 };
 
+struct cacheEntry
+{
+    const char *path;
+    uint32_t pathLength;
+    uint64_t inode;
+    uint64_t size;
+    int64_t mtimeSec;
+    int64_t mtimeNsec;
+    uint64_t contentHash;
+    uint32_t total;
+    uint32_t numWords;
+    const unsigned char *words;
+};
+
+struct tokenCache
+{
+    unsigned char *data;
+    size_t length;
+    struct cacheEntry *entries;
+    long numEntries;
+    long *table;
+    long tableSize;
+};
+
+struct storeRecord
+{
+    float KLD1;
+    float KLD2;
+    float JSD;
+    int32_t total;
+};
+
+struct storeFile
+{
+    const char *path;
+    uint32_t pathLength;
+    uint64_t inode;
+    uint64_t size;
+    int64_t mtimeSec;
+    int64_t mtimeNsec;
+    size_t offset;
+    const struct storeRecord *records;
+};
+
+struct pairStore
+{
+    unsigned char *map;
+    size_t length;
+    size_t end;
+    uint64_t numFiles;
+    struct storeFile *files;
+    long *table;
+    long tableSize;
+};
+
+struct runStats
+{
+    const char *phase[STATS_PHASES];
+    double wall[STATS_PHASES];
+    double user[STATS_PHASES];
+    double sys[STATS_PHASES];
+    long peakRSS[STATS_PHASES];
+    int numPhases;
+    double lastWall;
+    double lastUser;
+    double lastSys;
+    long files;
+    long directories;
+    long cachedFiles;
+    long duplicateFiles;
+    uint64_t bytes;
+    long tokens;
+    long uniqueWords;
+    double traversalCpu;
+    double tokenizeCpu;
+    long workers;
+    long pairsComputed;
+    long pairsStored;
+    long sharedTerms;
+    double pairTime;
+};
+
 struct args
 {
     char *baseDir;
     struct fileNode *fileHead;
-    struct meanNode *meanHead;
+    struct meanNode *means;
+    long numMeans;
+    char **vocab;
+    int vocabSize;
+    char *vocabText;
+    int *wordIds;
+    float *wordCounts;
+    int topK;
+    long limit;
+    double threshold;
+    char *cachePath;
+    struct tokenCache *cache;
+    char *storePath;
+    struct pairStore *store;
+    unsigned char *snapshot;
+    size_t snapshotLength;
+    struct runStats *stats;
+    bool useRing;
+    struct ingestEngine *ingest;
+    long memLimit;
+    long numEntries;
+    struct spillRuns *runs;
+    int ngram;
+    uint32_t featureDims;
+    int metric;
+};
+
+struct pairTask
+{
+    struct fileNode **files;
+    int numFiles;
+    struct fileNode **allFiles;
+    int numAllFiles;
+    int *memberStart;
+    int *members;
+    struct invertedIndex index;
+    long *storeIndex;
+    const struct storeFile *stored;
+    long numBlocks;
+    long numTiles;
+    long nextTile;
+    long limit;
+    double threshold;
+    long runLength;
+    struct spillRuns *runs;
+    pthread_mutex_t lock;
+    pthread_mutex_t outputLock;
+};
+
+struct pairWorker
+{
+    pthread_t id;
+    struct pairTask *task;
+    struct meanNode *results;
+    long numResults;
+    long capacity;
+    struct meanNode stream[STREAM_BUFFER];
+    int numStream;
+    long computed;
+    long copied;
+    long terms;
+};
+
+struct parallelLoop
+{
+    long count;
+    long chunk;
+    long next;
     pthread_mutex_t lock;
+    void (*body)(void *ctx, long start, long end);
+    void *ctx;
+};
+
+struct bucketEntry
+{
+    uint64_t hash;
+    int file;
+};
+
+struct lshTask
+{
+    struct fileNode **files;
+    int numFiles;
+    uint32_t *signatures;
+    uint64_t *candidates;
+    struct meanNode *results;
+};
+
+struct neighbour
+{
+    int file;
+    int other;
+    float JSD;
 };
 
 // Initializing functions first for better readablity
 
-struct fileNode *findThread(struct args *argsParam);
-void iterate(struct fileNode *filePtr, int fd);
-void *tokenize(struct args *argsParam);
-void *readDirectory(struct args *argsParam);
+void selectKernel(int metric);
+void divergenceScalar(const struct kernelBlock *block, double *KLD1, double *KLD2);
+void dotScalar(const struct kernelBlock *block, double *sum1, double *sum2);
+size_t scanScalar(const char *data, size_t pos, size_t length, bool *clean);
+void lowerScalar(char *out, const char *data, size_t n);
+#if defined(__x86_64__) || defined(__i386__)
+void divergenceSSE2(const struct kernelBlock *block, double *KLD1, double *KLD2);
+void divergenceAVX2(const struct kernelBlock *block, double *KLD1, double *KLD2);
+void dotSSE2(const struct kernelBlock *block, double *sum1, double *sum2);
+void dotAVX2(const struct kernelBlock *block, double *sum1, double *sum2);
+size_t scanSSE2(const char *data, size_t pos, size_t length, bool *clean);
+size_t scanAVX2(const char *data, size_t pos, size_t length, bool *clean);
+void lowerSSE2(char *out, const char *data, size_t n);
+void lowerAVX2(char *out, const char *data, size_t n);
+#endif
+
+void iterate(struct fileNode *filePtr, const char *data, size_t length);
+void addWord(struct wordTable *table, const char *newTok, size_t length);
+void growWords(struct wordTable *table);
+void finishWords(struct fileNode *filePtr, struct wordTable *table);
+uint64_t shingleId(struct args *argsParam, const uint64_t *window, long seen, int count);
+void countFeatures(struct fileNode *filePtr, uint64_t *features, long numFeatures);
+int compareFeatures(const void *a, const void *b);
+uint64_t featureKey(struct args *argsParam);
+size_t skipSpace(const char *data, size_t pos, size_t length);
+size_t foldToken(const char *data, size_t pos, size_t length, char *out, size_t *outLength);
+uint32_t decodeUTF8(const char *data, size_t pos, size_t length, int *bytes);
+int encodeUTF8(uint32_t code, char *out);
+int unicodeClass(uint32_t code);
+uint32_t foldCase(uint32_t code);
+void loadCache(struct args *argsParam);
+struct cacheEntry *lookupCache(struct tokenCache *cache, struct fileNode *filePtr);
+void readCached(struct fileNode *filePtr, struct cacheEntry *entry);
+void saveCache(struct args *argsParam);
+void freeCache(struct tokenCache *cache);
+uint64_t hashString(const char *string, size_t length);
+void loadStore(struct args *argsParam);
+long lookupStore(struct pairStore *store, struct fileNode *filePtr);
+long findStore(struct pairStore *store, const char *path);
+size_t storeEntryLength(uint32_t pathLength);
+struct meanNode storedMean(struct pairTask *task, int index1, int index2);
+void saveStore(struct args *argsParam);
+void writeStoreStat(unsigned char *pos, struct fileNode *filePtr);
+void freeStore(struct pairStore *store);
+void saveSnapshot(struct args *argsParam, char *snapshotPath);
+void loadSnapshot(struct args *argsParam, char *loadPath);
+void tokenize(struct fileNode *filePtr);
+bool checkFile(struct fileNode *filePtr);
+char *readFile(struct fileNode *filePtr, size_t *length);
+void finishFile(struct fileNode *filePtr);
+bool dedupFile(struct args *argsParam, struct fileNode *filePtr, const char *data, size_t length);
+bool sameContents(struct fileNode *original, struct fileNode *filePtr, const char *data, size_t length);
+uint64_t hashContent(const char *data, size_t length);
+void resolveDuplicates(struct args *argsParam);
+void startIngest(struct args *argsParam);
+void stopIngest(struct args *argsParam);
+void pushFile(struct ingestQueue *queue, struct fileNode *filePtr);
+struct fileNode *popFile(struct ingestQueue *queue, bool wait);
+void *ingestWorker(void *param);
+void *tokenWorker(void *param);
+void *mergeWorker(void *param);
+void mergeFile(struct args *argsParam, struct fileNode *filePtr);
+int mergeWord(struct args *argsParam, const char *word);
+bool setupRing(struct ingestEngine *engine);
+void *ringThread(void *param);
+void freeRing(struct ingestEngine *engine);
+void *dirThread(void *param);
+void readDirectory(struct args *argsParam, int dirFd, char *baseDir, int depth, struct fileList *list);
+void addEntry(struct args *argsParam, int dirFd, char *baseDir, int depth, struct fileList *list, struct dirWait *wait, const char *fileName, unsigned char type);
 struct fileNode *mergeSortedList(struct fileNode *a, struct fileNode *b);
 void split(struct fileNode *source, struct fileNode **frontRef, struct fileNode **backRef);
 void mergeSort(struct fileNode **headRef);
+void vocabulary(struct args *argsParam);
+int compareWords(const void *a, const void *b);
+void placeWords(struct args *argsParam);
 void anal(struct args *argsParam);
+void *analWorker(void *param);
+struct meanNode compare(struct fileNode *filePtr1, struct fileNode *filePtr2, int index1, int index2);
+struct meanNode finishMean(struct fileNode *filePtr1, struct fileNode *filePtr2, int index1, int index2, double sum1, double sum2, double shared1, double shared2, int common);
+double featureWeight(int metric, double prob, double norm);
+double fileNorm(int metric, struct fileNode *filePtr);
+void buildIndex(struct args *argsParam, struct pairTask *task);
+void addResult(struct pairWorker *worker, struct meanNode newMean);
+void expandResult(struct pairWorker *worker, struct meanNode newMean);
+void spillRun(struct pairWorker *worker);
+void mergeRuns(struct args *argsParam);
+int compareSpilled(const struct spillRecord *record1, const struct spillRecord *record2);
+int spillTemp(void);
+void *spillAlloc(struct args *argsParam, size_t length);
+void spillFree(struct args *argsParam, void *data, size_t length);
+long parseSize(const char *text);
+void flushStream(struct pairWorker *worker);
+void heapPush(struct meanNode *heap, long *size, long limit, struct meanNode newMean);
+int compareReport(const void *a, const void *b);
+struct fileNode **collectFiles(struct args *argsParam, int *numFiles);
+void groupFiles(struct pairTask *task);
+long numCores(void);
+void parallelFor(long count, long chunk, void (*body)(void *ctx, long start, long end), void *ctx);
+void *parallelWorker(void *param);
+void nearest(struct args *argsParam);
+void signatureBody(void *ctx, long start, long end);
+void candidateBody(void *ctx, long start, long end);
+uint64_t mix64(uint64_t x);
+int compareBuckets(const void *a, const void *b);
+int compareCandidates(const void *a, const void *b);
+int compareNeighbours(const void *a, const void *b);
+double seconds(clockid_t clock);
+void markPhase(struct runStats *stats, const char *name);
+void tallyFiles(struct args *argsParam);
+void printStats(struct runStats *stats);
+void printMean(float JSD, char *fileName1, char *fileName2);
 void printing(struct args *argsParam);
 void freeing(struct args *argsParam);
 int main(int argc, char *argv[]);
 
+// The kernels of the metrics, picked once by selectKernel() according to the CPU, and the one of the
+// --metric used by analWorker() and compare(), NULL when the metric only counts the shared words
+
+void (*divergenceKernel)(const struct kernelBlock *block, double *KLD1, double *KLD2) = divergenceScalar;
+void (*dotKernel)(const struct kernelBlock *block, double *sum1, double *sum2) = dotScalar;
+void (*pairKernel)(const struct kernelBlock *block, double *sum1, double *sum2) = divergenceScalar;
+
+// The tokenizer's kernels used by iterate(), and the class of every byte, also set up by selectKernel()
+
+size_t (*scanKernel)(const char *data, size_t pos, size_t length, bool *clean) = scanScalar;
+void (*lowerKernel)(char *out, const char *data, size_t n) = lowerScalar;
+unsigned char charClass[256];
+
+/*
+ * main() is the driver function that calls each function in the program in order to calculate
+ * the Jensen-Shannon Distance.
+ * 
+ * The function first checks if the paramters are valid, including a directory that can be opened.
+ * It will then initialize the initial args struct so that each thread created can use the shared
+ * linked lists. After each file is read, the function will sort the file linked list in decreasing
+ * number of tokens and give every distinct word an integer id. It will analyze the files and calculate
+ * the Jensen-Shannon Distance between each file and put the result in the mean array. It will then
+ * sort the mean array by decreasing number of tokens. Finally, it will print out each Jensen-Shannon
+ * Distance color-coded and then free all the allocated memory.
+ * 
+ * With --limit N, only the first N lines of the report are printed, and only those N
+ * results are ever kept in memory.
+ * 
+ * With --threshold T, nothing is kept at all. Every pair with a Jensen-Shannon Distance of
+ * at most T is printed as soon as it is computed, in no particular order.
+ * 
+ * With --cache FILE, the word counts of every file are saved to FILE after reading, and
+ * files that have not changed since the last run are not read again (see loadCache()).
+ * 
+ * With --store FILE, the result of every pair is saved to FILE, and the next run only
+ * computes the pairs that involve a new or changed file (see loadStore()).
+ * 
+ * With --snapshot FILE, the files are read and their word counts are written to FILE
+ * along with the vocabulary, and nothing is compared. With --load FILE, the files come
+ * from such a snapshot instead of a directory, so the comparison starts right away (see
+ * saveSnapshot()).
+ * 
+ * With --topk K, every pair is not compared. nearest() uses MinHash signatures to find the pairs
+ * of files that are likely to be similar, and only prints the K closest files for each file.
+ * 
+ * Files are read, tokenized and merged into the vocabulary by a pipeline of threads fed
+ * by the directory walk while the walk goes on (see startIngest()). With --io-uring, the
+ * reads go through an io_uring ring that keeps many of them in flight instead, when the
+ * kernel allows it.
+ * 
+ * With --mem-limit SIZE (in bytes, or with a K, M or G suffix), the word arrays and the
+ * inverted index are kept in temporary files mapped into memory, which the kernel can
+ * write out and drop, and the results are sorted in runs that fit the limit and merged
+ * from disk when printed (see spillRun()).
+ * 
+ * With --ngram N, the features of a file are the shingles of N words in a row instead of
+ * the words, each hashed into a 64-bit id, so files with the same words in a different
+ * order no longer look the same. With --features D, every feature id is hashed down to
+ * one of D values, which bounds the size of the vocabulary (see iterate()).
+ * 
+ * Files with the same contents are only tokenized and compared once. Their results are
+ * copied to every duplicate when they are reported (see dedupFile() and anal()).
+ * 
+ * With --metric NAME, the files are compared with another distance than the Jensen-Shannon
+ * Distance: cosine (1 - cosine similarity), jaccard (1 - Jaccard index of the sets of
+ * words) or hellinger. Every metric runs on the same pair engine with a kernel of its own,
+ * and the cheaper ones make a faster first pass (see finishMean()).
+ * 
+ * With --stats, the time and memory of every phase and a few counters are printed to
+ * stderr once the run is over (see printStats()).
+ * 
+ * Usage: ./detector [--topk K | --limit N | --threshold T] [--metric NAME]
+ *                   [--ngram N] [--features D] [--cache FILE]
+ *                   [--store FILE | --mem-limit SIZE] [--stats] [--io-uring] <directory>
+ *        ./detector --snapshot FILE [--ngram N] [--features D] [--cache FILE]
+ *                   [--stats] [--io-uring] <directory>
+ *        ./detector [--topk K | --limit N | --threshold T] [--metric NAME]
+ *                   [--store FILE | --mem-limit SIZE] [--stats] --load FILE
+ * 
+ * @param int argc and char *argv[] as terminal inputs
+ * 
+ */
+
+int main(int argc, char *argv[])
+{
+    // Reading the options and the base directory from the arguments passed in
+
+    char *baseDir = NULL;
+    int topK = 0;
+    long limit = 0;
+    double threshold = -1;
+    char *cachePath = NULL;
+    char *storePath = NULL;
+    char *snapshotPath = NULL;
+    char *loadPath = NULL;
+    bool stats = false;
+    bool useRing = false;
+    long memLimit = 0;
+    int ngram = 1;
+    uint32_t featureDims = 0;
+    int metric = METRIC_JSD;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--topk") == 0 && i + 1 < argc)
+        {
+            topK = atoi(argv[++i]);
+
+            if (topK < 1)
+            {
+                printf("Error: --topk needs a positive number, exiting\n");
+                exit(0);
+            }
+        }
+        else if (strcmp(argv[i], "--limit") == 0 && i + 1 < argc)
+        {
+            limit = atol(argv[++i]);
+
+            if (limit < 1)
+            {
+                printf("Error: --limit needs a positive number, exiting\n");
+                exit(0);
+            }
+        }
+        else if (strcmp(argv[i], "--threshold") == 0 && i + 1 < argc)
+        {
+            threshold = atof(argv[++i]);
+
+            if (threshold < 0)
+            {
+                printf("Error: --threshold needs a number of at least 0, exiting\n");
+                exit(0);
+            }
+        }
+        else if (strcmp(argv[i], "--cache") == 0 && i + 1 < argc)
+        {
+            cachePath = argv[++i];
+        }
+        else if (strcmp(argv[i], "--store") == 0 && i + 1 < argc)
+        {
+            storePath = argv[++i];
+        }
+        else if (strcmp(argv[i], "--snapshot") == 0 && i + 1 < argc)
+        {
+            snapshotPath = argv[++i];
+        }
+        else if (strcmp(argv[i], "--load") == 0 && i + 1 < argc)
+        {
+            loadPath = argv[++i];
+        }
+        else if (strcmp(argv[i], "--stats") == 0)
+        {
+            stats = true;
+        }
+        else if (strcmp(argv[i], "--io-uring") == 0)
+        {
+            useRing = true;
+        }
+        else if (strcmp(argv[i], "--mem-limit") == 0 && i + 1 < argc)
+        {
+            memLimit = parseSize(argv[++i]);
+
+            if (memLimit < 1)
+            {
+                printf("Error: --mem-limit needs a positive size, exiting\n");
+                exit(0);
+            }
+        }
+        else if (strcmp(argv[i], "--ngram") == 0 && i + 1 < argc)
+        {
+            ngram = atoi(argv[++i]);
+
+            if (ngram < 1 || ngram > NGRAM_MAX)
+            {
+                printf("Error: --ngram needs a number from 1 to %d, exiting\n", NGRAM_MAX);
+                exit(0);
+            }
+        }
+        else if (strcmp(argv[i], "--features") == 0 && i + 1 < argc)
+        {
+            long dims = atol(argv[++i]);
+
+            if (dims < 1 || dims > UINT32_MAX)
+            {
+                printf("Error: --features needs a positive number below 2^32, exiting\n");
+                exit(0);
+            }
+
+            featureDims = dims;
+        }
+        else if (strcmp(argv[i], "--metric") == 0 && i + 1 < argc)
+        {
+            const char *names[] = {"jsd", "cosine", "jaccard", "hellinger"};
+
+            metric = -1;
+
+            for (int m = 0; m < 4; m++)
+            {
+                if (strcmp(argv[i + 1], names[m]) == 0)
+                {
+                    metric = m;
+                }
+            }
+
+            if (metric == -1)
+            {
+                printf("Error: Unknown metric [%s], use jsd, cosine, jaccard or hellinger, exiting\n", argv[i + 1]);
+                exit(0);
+            }
+
+            i++;
+        }
+        else if (strncmp(argv[i], "--", 2) == 0)
+        {
+            printf("Error: Unknown option [%s], exiting\n", argv[i]);
+            exit(0);
+        }
+        else if (baseDir == NULL)
+        {
+            baseDir = argv[i];
+        }
+        else
+        {
+            printf("Error: Too many arguments passed in\nPlease enter a single base directory\n");
+            exit(0);
+        }
+    }
+
+    // Verifying that the output modes are not combined
+
+    if ((topK > 0) + (limit > 0) + (threshold >= 0) > 1)
+    {
+        printf("Error: --topk, --limit and --threshold cannot be combined, exiting\n");
+        exit(0);
+    }
+
+    // Verifying that every pair is kept when the results have to be stored
+
+    if (storePath != NULL && (topK > 0 || limit > 0 || threshold >= 0))
+    {
+        printf("Error: --store can only be used when printing every pair, exiting\n");
+        exit(0);
+    }
+
+    // Verifying that the results are not both stored and spilled, since the store keeps every pair anyway
+
+    if (storePath != NULL && memLimit > 0)
+    {
+        printf("Error: --mem-limit cannot be combined with --store, exiting\n");
+        exit(0);
+    }
+
+    // Verifying that a snapshot is only written from a directory, and only loaded in place of one
+
+    if (snapshotPath != NULL && (loadPath != NULL || storePath != NULL || topK > 0 || limit > 0 || threshold >= 0))
+    {
+        printf("Error: --snapshot only reads the files and cannot be combined with other options, exiting\n");
+        exit(0);
+    }
+
+    if (loadPath != NULL && (baseDir != NULL || cachePath != NULL || ngram > 1 || featureDims > 0))
+    {
+        printf("Error: --load replaces the base directory and cannot be combined with --cache, --ngram or --features, exiting\n");
+        exit(0);
+    }
+
+    // Verifying that a base directory was passed in
+
+    if (baseDir == NULL && loadPath == NULL)
+    {
+        printf("Error: No arguments passed in\nPlease enter a base directory\n");
+        exit(0);
+    }
+
+    // Verifying that the passed in directory can be opened
+
+    if (loadPath == NULL)
+    {
+        DIR *dir;
+        dir = opendir(baseDir);
+
+        if (dir == NULL)
+        {
+            printf("Error: Base directory cannot be opened, exiting\n");
+            exit(0);
+        }
+
+        closedir(dir);
+    }
+
+    // Initial args struct initialization
+
+    struct args *initialArgs = (struct args *)malloc(sizeof(struct args));
+    initialArgs->fileHead = NULL;
+    initialArgs->means = NULL;
+    initialArgs->numMeans = 0;
+    initialArgs->vocab = NULL;
+    initialArgs->vocabSize = 0;
+    initialArgs->vocabText = NULL;
+    initialArgs->wordIds = NULL;
+    initialArgs->wordCounts = NULL;
+    initialArgs->topK = topK;
+    initialArgs->limit = limit;
+    initialArgs->threshold = threshold;
+    initialArgs->cachePath = cachePath;
+    initialArgs->cache = NULL;
+    initialArgs->storePath = storePath;
+    initialArgs->store = NULL;
+    initialArgs->snapshot = NULL;
+    initialArgs->snapshotLength = 0;
+    initialArgs->stats = NULL;
+    initialArgs->useRing = useRing;
+    initialArgs->ingest = NULL;
+    initialArgs->memLimit = memLimit;
+    initialArgs->numEntries = 0;
+    initialArgs->runs = NULL;
+    initialArgs->ngram = ngram;
+    initialArgs->featureDims = featureDims;
+    initialArgs->metric = metric;
+
+    // Starting the clock of the first phase
+
+    struct runStats runStats;
+
+    if (stats)
+    {
+        memset(&runStats, 0, sizeof(struct runStats));
+        initialArgs->stats = &runStats;
+        markPhase(initialArgs->stats, NULL);
+    }
+
+    // Picking the tokenizer and pair kernels for this CPU and --metric
+
+    selectKernel(metric);
+
+    if (loadPath != NULL)
+    {
+        // Taking the files and the vocabulary straight from the snapshot
+
+        loadSnapshot(initialArgs, loadPath);
+        tallyFiles(initialArgs);
+        markPhase(initialArgs->stats, "load");
+    }
+    else
+    {
+        // Loading the word counts saved by the last run
+
+        if (initialArgs->cachePath != NULL)
+        {
+            loadCache(initialArgs);
+        }
+
+        initialArgs->baseDir = baseDir;
+
+        // Calling readDirectory() to find all the files and hand them to the reading threads
+        // Every file has been read by the time it returns, so the file list is complete
+
+        struct fileList files = {NULL, NULL};
+        int baseFd = open(initialArgs->baseDir, O_RDONLY | O_DIRECTORY);
+
+        if (baseFd == -1)
+        {
+            printf("Error: Base directory cannot be opened, exiting\n");
+            exit(0);
+        }
+
+        startIngest(initialArgs);
+        readDirectory(initialArgs, baseFd, initialArgs->baseDir, 0, &files);
+        stopIngest(initialArgs);
+
+        initialArgs->fileHead = files.head;
+        resolveDuplicates(initialArgs);
+        tallyFiles(initialArgs);
+        markPhase(initialArgs->stats, "read");
+
+        // Verifying that there is data written to the file linked list
+
+        struct fileNode *ptr = initialArgs->fileHead;
+
+        if (ptr == NULL)
+        {
+            printf("Error: No data, exiting\n");
+            exit(0);
+        }
+
+        // Soring the file nodes in decreasing order
+
+        mergeSort(&initialArgs->fileHead);
+        markPhase(initialArgs->stats, "sort");
+
+        // Assigning every distinct word its final integer id and moving each file's words into the shared arrays
+
+        vocabulary(initialArgs);
+        markPhase(initialArgs->stats, "vocabulary");
+
+        // Saving the word counts of every file for the next run
+
+        if (initialArgs->cachePath != NULL)
+        {
+            saveCache(initialArgs);
+            markPhase(initialArgs->stats, "cache");
+        }
+    }
+
+    if (initialArgs->stats != NULL)
+    {
+        initialArgs->stats->uniqueWords = initialArgs->vocabSize;
+    }
+
+    // Writing the snapshot instead of comparing anything
+
+    if (snapshotPath != NULL)
+    {
+        saveSnapshot(initialArgs, snapshotPath);
+        markPhase(initialArgs->stats, "snapshot");
+
+        freeing(initialArgs);
+
+        if (stats)
+        {
+            markPhase(&runStats, "free");
+            printStats(&runStats);
+        }
+
+        return 0;
+    }
+
+    // Analyzing each file and calculating the Jensen-Shannon Distance between each file
+
+    if (initialArgs->topK > 0)
+    {
+        // Only comparing likely pairs and printing the closest files for each file
+
+        nearest(initialArgs);
+        markPhase(initialArgs->stats, "nearest");
+    }
+    else
+    {
+        // Loading the results of the last run so that only new pairs are computed
+
+        if (initialArgs->storePath != NULL)
+        {
+            loadStore(initialArgs);
+        }
+
+        anal(initialArgs);
+        markPhase(initialArgs->stats, "analysis");
+
+        // Saving the results for the next run
+
+        if (initialArgs->storePath != NULL)
+        {
+            saveStore(initialArgs);
+            markPhase(initialArgs->stats, "store");
+        }
+
+        // Printing the results
+
+        printing(initialArgs);
+        markPhase(initialArgs->stats, "output");
+    }
+
+    // Freeing the allocated memory
+
+    freeing(initialArgs);
+
+    // Printing the stats last, since the report on stdout is done
+
+    if (stats)
+    {
+        markPhase(&runStats, "free");
+        printStats(&runStats);
+    }
+
+    return 0;
+}
+
+/*
+ * readDirectory() goes through the specified directory, finds all the files, 
+ * and creates the necessary threads.
+ * 
+ * The directory is read through its descriptor, in batches of WALK_BUFFER bytes of
+ * entries at a time with getdents64() on Linux (readdir() elsewhere), and every entry is
+ * handed to addEntry(). The descriptor stays open until every thread created for the
+ * directory has been joined and every file of it has been read, so the entries are
+ * always opened relative to it with openat() and fstatat(), and no path is ever looked
+ * up from the root again.
+ * 
+ * There is no shared file list while the threads are running. Every call builds its
+ * own list of the entries it found, joins the threads it created, and then concatenates
+ * the lists collected by its subdirectories onto the end. Nothing is locked, and each
+ * append is O(1) through the tail pointer.
+ * 
+ * @param struct args with the shared data
+ * @param int dirFd as the open directory to read, which is closed at the end
+ * @param char *baseDir as the path of the directory
+ * @param int depth as the number of levels below the base directory
+ * @param struct fileList to append the found files to
+ * 
+ */
+
+void readDirectory(struct args *argsParam, int dirFd, char *baseDir, int depth, struct fileList *list)
+{
+    // Counting the files of this directory that are still being read
+
+    struct dirWait wait;
+    wait.pending = 0;
+
+    if (pthread_mutex_init(&wait.lock, NULL) != 0 || pthread_cond_init(&wait.done, NULL) != 0)
+    {
+        printf("Error: Mutex initialization failed, exiting\n");
+        exit(0);
+    }
+
+#if defined(__linux__)
+    // Reading the entries in large batches straight from the kernel
+
+    char *buffer = (char *)malloc(WALK_BUFFER);
+    long bytes;
+
+    while ((bytes = syscall(SYS_getdents64, dirFd, buffer, WALK_BUFFER)) > 0)
+    {
+        long pos = 0;
+
+        while (pos < bytes)
+        {
+            // The record layout of getdents64(): inode, offset, record length, type and name
+
+            unsigned short recordLength;
+            memcpy(&recordLength, buffer + pos + 16, sizeof(unsigned short));
+
+            addEntry(argsParam, dirFd, baseDir, depth, list, &wait, buffer + pos + 19, (unsigned char)buffer[pos + 18]);
+
+            pos += recordLength;
+        }
+    }
+
+    free(buffer);
+
+    if (bytes < 0)
+    {
+        printf("Error: [%s] directory cannot be read, returning\n", baseDir);
+    }
+#else
+    // Reading the entries through a copy of the descriptor, since closedir() closes it
+
+    int copyFd = dup(dirFd);
+    DIR *dir = (copyFd == -1) ? NULL : fdopendir(copyFd);
+    struct dirent *dirent;
+
+    if (dir == NULL)
+    {
+        printf("Error: [%s] directory cannot be read, returning\n", baseDir);
+    }
+    else
+    {
+        while ((dirent = readdir(dir)) != NULL)
+        {
+            addEntry(argsParam, dirFd, baseDir, depth, list, &wait, dirent->d_name, dirent->d_type);
+        }
+
+        closedir(dir);
+    }
+#endif
+
+    // Joining the threads created above and concatenating the lists collected by the subdirectories
+    // The loop stops at the last entry of this directory, since the spliced lists are already joined
+
+    struct fileNode *last = list->tail;
+    struct fileNode *filePtr = (last == NULL) ? NULL : list->head;
+
+    while (filePtr != NULL)
+    {
+        if (filePtr->threaded)
+        {
+            pthread_join(filePtr->id, NULL);
+        }
+
+        if (filePtr->folder && filePtr->children.head != NULL)
+        {
+            list->tail->next = filePtr->children.head;
+            list->tail = filePtr->children.tail;
+        }
+
+        filePtr = (filePtr == last) ? NULL : filePtr->next;
+    }
+
+    // Waiting for the files of this directory to be read before closing it
+
+    pthread_mutex_lock(&wait.lock);
+
+    while (wait.pending > 0)
+    {
+        pthread_cond_wait(&wait.done, &wait.lock);
+    }
+
+    pthread_mutex_unlock(&wait.lock);
+
+    pthread_mutex_destroy(&wait.lock);
+    pthread_cond_destroy(&wait.done);
+
+    close(dirFd);
+}
+
+/*
+ * addEntry() adds one entry of a directory to the directory's list and starts reading it.
+ * 
+ * Only directories and regular files are kept. Filesystems that do not fill in the type
+ * of an entry report DT_UNKNOWN, and only then is the entry looked up with fstatat(),
+ * without following symbolic links, like the types the kernel reports. The path of the
+ * entry is built once with the lengths already known.
+ * 
+ * Every file is queued for the reading threads right away, so files are read while the
+ * walk goes on, and counted in the directory's wait until it has been read. A directory
+ * gets a thread running dirThread() if it is at most WALK_THREAD_DEPTH levels down, and
+ * is read right here by the current thread otherwise, so a deep tree does not create a
+ * thread for every one of its directories.
+ * 
+ * @param struct args with the shared data
+ * @param int dirFd as the open directory holding the entry
+ * @param char *baseDir as the path of that directory
+ * @param int depth as the number of levels below the base directory of that directory
+ * @param struct fileList to append the entry to
+ * @param struct dirWait counting the files of the directory still being read
+ * @param const char *fileName as the name of the entry
+ * @param unsigned char type as the type of the entry, as in struct dirent
+ * 
+ */
+
+void addEntry(struct args *argsParam, int dirFd, char *baseDir, int depth, struct fileList *list, struct dirWait *wait, const char *fileName, unsigned char type)
+{
+    // Skips the "." and ".." files in each directory
+
+    if (strcmp(fileName, ".") == 0 || strcmp(fileName, "..") == 0)
+    {
+        return;
+    }
+
+    // Finding out the type of the entry when the filesystem does not say
+
+    if (type == DT_UNKNOWN)
+    {
+        struct stat info;
+
+        if (fstatat(dirFd, fileName, &info, AT_SYMLINK_NOFOLLOW) == 0)
+        {
+            type = S_ISDIR(info.st_mode) ? DT_DIR : (S_ISREG(info.st_mode) ? DT_REG : DT_UNKNOWN);
+        }
+    }
+
+    // Skips all files that are not a directory or files with ASCII text
+
+    if (type != DT_DIR && type != DT_REG)
+    {
+        return;
+    }
+
+    // Initializing a new file node
+
+    size_t baseLength = strlen(baseDir);
+    size_t nameLength = strlen(fileName);
+
+    struct fileNode *newFile = (struct fileNode *)malloc(sizeof(struct fileNode));
+    newFile->total = 0;
+    newFile->words = NULL;
+    newFile->ids = NULL;
+    newFile->counts = NULL;
+    newFile->features = NULL;
+    newFile->numWords = 0;
+    newFile->folder = (type == DT_DIR);
+    newFile->argsParam = argsParam;
+    newFile->statted = false;
+    newFile->cached = false;
+    newFile->cpuTime = 0;
+    newFile->children.head = NULL;
+    newFile->children.tail = NULL;
+    newFile->dirFd = dirFd;
+    newFile->depth = depth + 1;
+    newFile->wait = wait;
+    newFile->entry = NULL;
+    newFile->contentHash = 0;
+    newFile->original = NULL;
+    newFile->group = 0;
+    newFile->data = NULL;
+    newFile->length = 0;
+    newFile->queueNext = NULL;
+    newFile->next = NULL;
+
+    newFile->fileName = (char *)malloc(sizeof(char) * (baseLength + nameLength + 2));
+    memcpy(newFile->fileName, baseDir, baseLength);
+    newFile->fileName[baseLength] = '/';
+    memcpy(newFile->fileName + baseLength + 1, fileName, nameLength + 1);
+    newFile->nameOffset = baseLength + 1;
+
+    // Appending the file node to this directory's own list before anything reads it
+
+    if (list->tail == NULL)
+    {
+        list->head = newFile;
+    }
+    else
+    {
+        list->tail->next = newFile;
+    }
+
+    list->tail = newFile;
+
+    // If the file found is a ASCII text file, it is queued for the reading threads
+
+    if (!newFile->folder)
+    {
+        newFile->threaded = false;
+
+        pthread_mutex_lock(&wait->lock);
+        wait->pending++;
+        pthread_mutex_unlock(&wait->lock);
+
+        pushFile(&argsParam->ingest->files, newFile);
+        return;
+    }
+
+    // If the file found is a directory, the new thread recurses with dirThread(), unless it is too deep
+
+    newFile->threaded = (newFile->depth <= WALK_THREAD_DEPTH);
+
+    if (!newFile->threaded)
+    {
+        dirThread(newFile);
+        return;
+    }
+
+    int err = pthread_create(&newFile->id, NULL, dirThread, newFile);
+
+    if (err != 0)
+    {
+        printf("Error: Creating thread unsuccessful, exiting\n");
+        exit(0);
+    }
+}
+
+/*
+ * dirThread() is the starting point of every directory thread. The thread receives
+ * the file node of the directory it is responsible for, opens it relative to the
+ * directory above, and calls readDirectory() on it, collecting everything found into
+ * the node's children list for the parent to splice in. Directories deeper than
+ * WALK_THREAD_DEPTH are handed to it directly, on the thread of the directory above.
+ * 
+ * @param struct fileNode of the directory
+ * 
+ */
+
+void *dirThread(void *param)
+{
+    struct fileNode *dirPtr = (struct fileNode *)param;
+
+    int dirFd = openat(dirPtr->dirFd, dirPtr->fileName + dirPtr->nameOffset, O_RDONLY | O_DIRECTORY);
+
+    if (dirFd == -1)
+    {
+        printf("Error: [%s] directory cannot be opened, returning\n", dirPtr->fileName);
+        return 0;
+    }
+
+    readDirectory(dirPtr->argsParam, dirFd, dirPtr->fileName, dirPtr->depth, &dirPtr->children);
+
+    if (dirPtr->argsParam->stats != NULL && dirPtr->threaded)
+    {
+        dirPtr->cpuTime = seconds(CLOCK_THREAD_CPUTIME_ID);
+    }
+
+    return 0;
+}
+
+/*
+ * tokenize() reads one file with blocking reads and tokenizes it, on one of the reading
+ * threads of ingestWorker().
+ * 
+ * It first calls checkFile(), and if the cache has the file, the words are copied from
+ * the cache instead of reading the file. Otherwise it will read the whole file into
+ * memory with readFile(), returning an error if the file cannot be opened, and call
+ * iterate() on the contents to count the words of the file node. Either way, nothing is
+ * copied or counted if dedupFile() finds that a file with the same contents has already
+ * been seen, so the files are grouped the same with or without a cache.
+ * 
+ * @param struct fileNode of the file to read
+ * 
+ */
+
+void tokenize(struct fileNode *filePtr)
+{
+    if (checkFile(filePtr))
+    {
+        if (!dedupFile(filePtr->argsParam, filePtr, NULL, filePtr->size))
+        {
+            readCached(filePtr, filePtr->entry);
+        }
+
+        return;
+    }
+
+    size_t length;
+    char *data = readFile(filePtr, &length);
+
+    if (data != NULL)
+    {
+        // Iterates throught the contents of the file and counts the words of the corresponding file node, unless it is a duplicate
+
+        if (!dedupFile(filePtr->argsParam, filePtr, data, length))
+        {
+            iterate(filePtr, data, length);
+        }
+
+        free(data);
+    }
+}
+
+/*
+ * checkFile() records the inode, size and modification time of a file, and looks the
+ * file up in the cache when there is one.
+ * 
+ * @param struct fileNode of the file
+ * 
+ * @return true if the cache has the file unchanged, with its entry in the file node
+ * 
+ */
+
+bool checkFile(struct fileNode *filePtr)
+{
+    struct tokenCache *cache = filePtr->argsParam->cache;
+    struct stat info;
+
+    if (fstatat(filePtr->dirFd, filePtr->fileName + filePtr->nameOffset, &info, 0) != 0)
+    {
+        return false;
+    }
+
+    filePtr->statted = true;
+    filePtr->inode = info.st_ino;
+    filePtr->size = info.st_size;
+    filePtr->mtimeSec = info.st_mtim.tv_sec;
+    filePtr->mtimeNsec = info.st_mtim.tv_nsec;
+
+    filePtr->entry = (cache == NULL) ? NULL : lookupCache(cache, filePtr);
+    filePtr->cached = (filePtr->entry != NULL);
+
+    return filePtr->cached;
+}
+
+/*
+ * readFile() reads a whole file into memory with pread(), relative to the descriptor of
+ * its directory. The buffer starts at the size checkFile() recorded and grows if the file
+ * turns out to be longer, so the whole file is always read.
+ * 
+ * @param struct fileNode of the file to read
+ * @param size_t *length to store the number of bytes read in
+ * 
+ * @return buffer with the contents, or NULL if the file is not accessible
+ * 
+ */
+
+char *readFile(struct fileNode *filePtr, size_t *length)
+{
+    // Verifies that the current file can be opened
+
+    int fd = openat(filePtr->dirFd, filePtr->fileName + filePtr->nameOffset, O_RDONLY);
+
+    if (fd == -1)
+    {
+        printf("Error: File [%s] is not accessible, returning\n", filePtr->fileName);
+        return NULL;
+    }
+
+    size_t capacity = (filePtr->statted ? filePtr->size : 0) + 1;
+    char *data = (char *)malloc(capacity);
+    size_t used = 0;
+    ssize_t bytes;
+
+    while ((bytes = pread(fd, data + used, capacity - used, used)) > 0)
+    {
+        used += bytes;
+
+        if (used == capacity)
+        {
+            capacity *= 2;
+            data = (char *)realloc(data, capacity);
+        }
+    }
+
+    close(fd);
+
+    if (bytes < 0)
+    {
+        printf("Error: File [%s] is not accessible, returning\n", filePtr->fileName);
+        free(data);
+        return NULL;
+    }
+
+    *length = used;
+
+    return data;
+}
+
+/*
+ * finishFile() marks a file as read, waking up the thread of its directory once the
+ * directory has no files left being read.
+ * 
+ * @param struct fileNode of the file that was read
+ * 
+ */
+
+void finishFile(struct fileNode *filePtr)
+{
+    struct dirWait *wait = filePtr->wait;
+
+    pthread_mutex_lock(&wait->lock);
+
+    if (--wait->pending == 0)
+    {
+        pthread_cond_signal(&wait->done);
+    }
+
+    pthread_mutex_unlock(&wait->lock);
+}
+
+/*
+ * dedupFile() checks whether a file has the same contents as a file already read, before
+ * it is tokenized.
+ * 
+ * The contents are hashed with hashContent(), and a table of the distinct contents seen
+ * so far is searched for the same hash and length. The first file with some contents is
+ * added to the table and tokenized as usual. A later file with the same hash and length
+ * is compared with the first one byte for byte by sameContents(), and only if they are
+ * the same is it not tokenized at all, and only points to the first one as its original,
+ * which gives it its words once every file has been read (see resolveDuplicates()). A
+ * file that only shares the hash is kept on its own and tokenized as usual.
+ * 
+ * A file found in the cache is not read, so it is looked up with the hash saved in its
+ * cache entry instead.
+ * 
+ * @param struct args with the engine
+ * @param struct fileNode of the file
+ * @param const char *data as the contents of the file, or NULL for a file found in the cache
+ * @param size_t length as the number of bytes in the contents
+ * 
+ * @return true if the file is a duplicate and must not be tokenized
+ * 
+ */
+
+bool dedupFile(struct args *argsParam, struct fileNode *filePtr, const char *data, size_t length)
+{
+    struct ingestEngine *engine = argsParam->ingest;
+    struct fileNode *match = NULL;
+
+    filePtr->contentHash = (data == NULL) ? filePtr->entry->contentHash : hashContent(data, length);
+    filePtr->length = length;
+
+    pthread_mutex_lock(&engine->dedupLock);
+
+    long slot = filePtr->contentHash & (engine->dedupTableSize - 1);
+
+    while (engine->dedupTable[slot] != NULL)
+    {
+        struct fileNode *seen = engine->dedupTable[slot];
+
+        if (seen->contentHash == filePtr->contentHash && seen->length == length)
+        {
+            match = seen;
+            break;
+        }
+
+        slot = (slot + 1) & (engine->dedupTableSize - 1);
+    }
+
+    if (match == NULL)
+    {
+        engine->dedupTable[slot] = filePtr;
+        engine->dedupCount++;
+    }
+
+    // Doubling the table once it is half full
+
+    if (2 * engine->dedupCount > engine->dedupTableSize)
+    {
+        struct fileNode **oldTable = engine->dedupTable;
+        long oldSize = engine->dedupTableSize;
+
+        engine->dedupTableSize *= 2;
+        engine->dedupTable = (struct fileNode **)calloc(engine->dedupTableSize, sizeof(struct fileNode *));
+
+        for (long t = 0; t < oldSize; t++)
+        {
+            if (oldTable[t] != NULL)
+            {
+                long rehash = oldTable[t]->contentHash & (engine->dedupTableSize - 1);
+
+                while (engine->dedupTable[rehash] != NULL)
+                {
+                    rehash = (rehash + 1) & (engine->dedupTableSize - 1);
+                }
+
+                engine->dedupTable[rehash] = oldTable[t];
+            }
+        }
+
+        free(oldTable);
+    }
+
+    pthread_mutex_unlock(&engine->dedupLock);
+
+    // The comparison reads the files again, so it is done without holding the lock
+
+    if (match != NULL && sameContents(match, filePtr, data, length))
+    {
+        filePtr->original = match;
+        return true;
+    }
+
+    return false;
+}
+
+/*
+ * sameContents() compares the contents of a file with those of the earlier file that
+ * dedupFile() found with the same hash and length, byte for byte.
+ * 
+ * The contents of the earlier file were freed once it was tokenized, and the descriptor
+ * of its directory may already be closed, so it is read again through its path, one
+ * block of DEDUP_BLOCK bytes at a time. A file found in the cache has no contents in
+ * memory either, and is read with readFile() first. Only files that share a hash with
+ * an earlier one are ever read again.
+ * 
+ * @param struct fileNode of the earlier file
+ * @param struct fileNode of the file
+ * @param const char *data as the contents of the file, or NULL to read them
+ * @param size_t length as the number of bytes in the contents of both files
+ * 
+ * @return true if both files have the same contents
+ * 
+ */
+
+bool sameContents(struct fileNode *original, struct fileNode *filePtr, const char *data, size_t length)
+{
+    char *contents = NULL;
+
+    if (data == NULL)
+    {
+        size_t readLength;
+        contents = readFile(filePtr, &readLength);
+
+        if (contents == NULL || readLength != length)
+        {
+            free(contents);
+            return false;
+        }
+
+        data = contents;
+    }
+
+    int fd = open(original->fileName, O_RDONLY);
+    bool same = (fd != -1);
+    char *block = (char *)malloc(DEDUP_BLOCK);
+    size_t done = 0;
+
+    while (same && done < length)
+    {
+        size_t wanted = (length - done < DEDUP_BLOCK) ? length - done : DEDUP_BLOCK;
+        ssize_t bytes = pread(fd, block, wanted, done);
+
+        if (bytes <= 0 || memcmp(block, data + done, bytes) != 0)
+        {
+            same = false;
+        }
+        else
+        {
+            done += bytes;
+        }
+    }
+
+    if (fd != -1)
+    {
+        close(fd);
+    }
+
+    free(block);
+    free(contents);
+
+    return same;
+}
+
+/*
+ * hashContent() is the 64-bit xxHash (XXH64) of a block of memory, with a seed of 0. It
+ * reads 32 bytes per round in four independent lanes, so hashing runs far faster than the
+ * tokenizer and costs little next to reading the file.
+ * 
+ * @param const char *data as the memory to hash
+ * @param size_t length as the number of bytes
+ * 
+ * @return hash of the memory
+ * 
+ */
+
+uint64_t hashContent(const char *data, size_t length)
+{
+    const uint64_t prime1 = 0x9E3779B185EBCA87ULL;
+    const uint64_t prime2 = 0xC2B2AE3D27D4EB4FULL;
+    const uint64_t prime3 = 0x165667B19E3779F9ULL;
+    const uint64_t prime4 = 0x85EBCA77C2B2AE63ULL;
+    const uint64_t prime5 = 0x27D4EB2F165667C5ULL;
+
+    const unsigned char *pos = (const unsigned char *)data;
+    const unsigned char *end = pos + length;
+    uint64_t hash;
+
+    if (length >= 32)
+    {
+        uint64_t lanes[4] = {prime1 + prime2, prime2, 0, -prime1};
+
+        // Mixing 8 bytes into each lane per round
+
+        while (pos + 32 <= end)
+        {
+            for (int l = 0; l < 4; l++)
+            {
+                uint64_t input;
+                memcpy(&input, pos + 8 * l, sizeof(uint64_t));
+
+                lanes[l] += input * prime2;
+                lanes[l] = (lanes[l] << 31) | (lanes[l] >> 33);
+                lanes[l] *= prime1;
+            }
+
+            pos += 32;
+        }
+
+        hash = ((lanes[0] << 1) | (lanes[0] >> 63)) + ((lanes[1] << 7) | (lanes[1] >> 57)) + ((lanes[2] << 12) | (lanes[2] >> 52)) + ((lanes[3] << 18) | (lanes[3] >> 46));
+
+        for (int l = 0; l < 4; l++)
+        {
+            uint64_t lane = lanes[l] * prime2;
+            lane = ((lane << 31) | (lane >> 33)) * prime1;
+            hash = (hash ^ lane) * prime1 + prime4;
+        }
+    }
+    else
+    {
+        hash = prime5;
+    }
+
+    hash += length;
+
+    // Mixing in the bytes left over, 8, then 4, then 1 at a time
+
+    while (pos + 8 <= end)
+    {
+        uint64_t input;
+        memcpy(&input, pos, sizeof(uint64_t));
+
+        input *= prime2;
+        input = ((input << 31) | (input >> 33)) * prime1;
+        hash ^= input;
+        hash = ((hash << 27) | (hash >> 37)) * prime1 + prime4;
+        pos += 8;
+    }
+
+    if (pos + 4 <= end)
+    {
+        uint32_t input;
+        memcpy(&input, pos, sizeof(uint32_t));
+
+        hash ^= (uint64_t)input * prime1;
+        hash = ((hash << 23) | (hash >> 41)) * prime2 + prime3;
+        pos += 4;
+    }
+
+    while (pos < end)
+    {
+        hash ^= (*pos) * prime5;
+        hash = ((hash << 11) | (hash >> 53)) * prime1;
+        pos++;
+    }
+
+    // Avalanching the final hash
+
+    hash ^= hash >> 33;
+    hash *= prime2;
+    hash ^= hash >> 29;
+    hash *= prime3;
+    hash ^= hash >> 32;
+
+    return hash;
+}
+
+/*
+ * resolveDuplicates() gives every duplicate found by dedupFile() the token total of its
+ * original, once every file has been read, so the duplicates sort next to their original.
+ * 
+ * @param struct args with the file linked list
+ * 
+ */
+
+void resolveDuplicates(struct args *argsParam)
+{
+    struct fileNode *filePtr = argsParam->fileHead;
+
+    while (filePtr != NULL)
+    {
+        if (filePtr->original != NULL)
+        {
+            filePtr->total = filePtr->original->total;
+        }
+
+        filePtr = filePtr->next;
+    }
+}
+
+/*
+ * startIngest() starts the pipeline of threads that read the files the directory walk
+ * finds, tokenize them and merge their words into the vocabulary.
+ * 
+ * The walk pushes every file onto a queue of at most INGEST_QUEUE files, and waits when it
+ * gets ahead of the readers. By default, INGEST_READERS threads (or one per
+ * core, if there are more cores) take files off it and read and tokenize each one with
+ * blocking reads through tokenize(), so that many reads are waiting on the disk at once.
+ * 
+ * With --io-uring, a single ring thread takes the files instead and keeps up to
+ * RING_DEPTH reads in flight in an io_uring ring (see ringThread()). Every file it has
+ * read goes onto a second queue, where one tokenizing thread per core picks it up, so
+ * reading and tokenizing overlap without a thread blocking on every read. If the kernel
+ * does not allow io_uring, the blocking readers are used.
+ * 
+ * Tokenized files go onto a last queue of at most MERGE_QUEUE files, where a single merge
+ * thread gives their words provisional ids (see mergeWorker()), so most of the work of
+ * vocabulary() is done by the time the walk is over.
+ * 
+ * @param struct args to attach the engine to
+ * 
+ */
+
+void startIngest(struct args *argsParam)
+{
+    struct ingestEngine *engine = (struct ingestEngine *)malloc(sizeof(struct ingestEngine));
+    struct ingestQueue *queues[3] = {&engine->files, &engine->buffers, &engine->merged};
+    long capacities[3] = {INGEST_QUEUE, 0, MERGE_QUEUE};
+
+    for (int q = 0; q < 3; q++)
+    {
+        queues[q]->head = NULL;
+        queues[q]->tail = NULL;
+        queues[q]->size = 0;
+        queues[q]->capacity = capacities[q];
+        queues[q]->closed = false;
+
+        if (pthread_mutex_init(&queues[q]->lock, NULL) != 0 || pthread_cond_init(&queues[q]->changed, NULL) != 0)
+        {
+            printf("Error: Mutex initialization failed, exiting\n");
+            exit(0);
+        }
+    }
+
+    engine->ring = argsParam->useRing && setupRing(engine);
+    engine->ringCpuTime = 0;
+    engine->mergeCpuTime = 0;
+    engine->numThreads = numCores();
+
+    if (!engine->ring && engine->numThreads < INGEST_READERS)
+    {
+        engine->numThreads = INGEST_READERS;
+    }
+
+    engine->threads = (pthread_t *)malloc(sizeof(pthread_t) * engine->numThreads);
+    engine->cpuTimes = (double *)calloc(engine->numThreads, sizeof(double));
+    argsParam->ingest = engine;
+
+    // The merge thread's hash table from word to provisional id starts small and doubles as the vocabulary grows
+
+    engine->mergeTableSize = 1024;
+    engine->mergeTable = (int *)malloc(sizeof(int) * engine->mergeTableSize);
+
+    for (long t = 0; t < engine->mergeTableSize; t++)
+    {
+        engine->mergeTable[t] = -1;
+    }
+
+    // The table of distinct contents for dedupFile() grows the same way
+
+    engine->dedupTableSize = 1024;
+    engine->dedupCount = 0;
+    engine->dedupTable = (struct fileNode **)calloc(engine->dedupTableSize, sizeof(struct fileNode *));
+
+    if (pthread_mutex_init(&engine->dedupLock, NULL) != 0)
+    {
+        printf("Error: Mutex initialization failed, exiting\n");
+        exit(0);
+    }
+
+    if (pthread_create(&engine->mergeId, NULL, mergeWorker, argsParam) != 0)
+    {
+        printf("Error: Creating thread unsuccessful, exiting\n");
+        exit(0);
+    }
+
+    if (engine->ring && pthread_create(&engine->ringId, NULL, ringThread, argsParam) != 0)
+    {
+        printf("Error: Creating thread unsuccessful, exiting\n");
+        exit(0);
+    }
+
+    for (int t = 0; t < engine->numThreads; t++)
+    {
+        if (pthread_create(&engine->threads[t], NULL, engine->ring ? tokenWorker : ingestWorker, argsParam) != 0)
+        {
+            printf("Error: Creating thread unsuccessful, exiting\n");
+            exit(0);
+        }
+    }
+}
+
+/*
+ * stopIngest() closes the queues once the walk is over and every file has been read,
+ * joins the threads of startIngest() and frees the engine. The merge queue is only closed
+ * once every thread that feeds it has been joined, so no file is left out of the merge.
+ * 
+ * @param struct args with the engine
+ * 
+ */
+
+void stopIngest(struct args *argsParam)
+{
+    struct ingestEngine *engine = argsParam->ingest;
+    struct ingestQueue *queues[3] = {&engine->files, &engine->buffers, &engine->merged};
+
+    for (int q = 0; q < 2; q++)
+    {
+        pthread_mutex_lock(&queues[q]->lock);
+        queues[q]->closed = true;
+        pthread_cond_broadcast(&queues[q]->changed);
+        pthread_mutex_unlock(&queues[q]->lock);
+    }
+
+    if (engine->ring)
+    {
+        pthread_join(engine->ringId, NULL);
+        freeRing(engine);
+    }
+
+    for (int t = 0; t < engine->numThreads; t++)
+    {
+        pthread_join(engine->threads[t], NULL);
+    }
+
+    pthread_mutex_lock(&engine->merged.lock);
+    engine->merged.closed = true;
+    pthread_cond_broadcast(&engine->merged.changed);
+    pthread_mutex_unlock(&engine->merged.lock);
+
+    pthread_join(engine->mergeId, NULL);
+
+    // Adding the CPU time of the reading and merging threads for --stats
+
+    if (argsParam->stats != NULL)
+    {
+        argsParam->stats->tokenizeCpu += engine->ringCpuTime + engine->mergeCpuTime;
+
+        for (int t = 0; t < engine->numThreads; t++)
+        {
+            argsParam->stats->tokenizeCpu += engine->cpuTimes[t];
+        }
+    }
+
+    for (int q = 0; q < 3; q++)
+    {
+        pthread_mutex_destroy(&queues[q]->lock);
+        pthread_cond_destroy(&queues[q]->changed);
+    }
+
+    pthread_mutex_destroy(&engine->dedupLock);
+    free(engine->dedupTable);
+    free(engine->mergeTable);
+    free(engine->threads);
+    free(engine->cpuTimes);
+    free(engine);
+    argsParam->ingest = NULL;
+}
+
+/*
+ * pushFile() appends a file node to a queue and wakes up a thread waiting on it. If the
+ * queue has a capacity and is full, it first waits for a file to be taken off it.
+ * 
+ * @param struct ingestQueue to append to
+ * @param struct fileNode to append
+ * 
+ */
+
+void pushFile(struct ingestQueue *queue, struct fileNode *filePtr)
+{
+    filePtr->queueNext = NULL;
+
+    pthread_mutex_lock(&queue->lock);
+
+    while (queue->capacity > 0 && queue->size >= queue->capacity)
+    {
+        pthread_cond_wait(&queue->changed, &queue->lock);
+    }
+
+    if (queue->tail == NULL)
+    {
+        queue->head = filePtr;
+    }
+    else
+    {
+        queue->tail->queueNext = filePtr;
+    }
+
+    queue->tail = filePtr;
+    queue->size++;
+
+    pthread_cond_broadcast(&queue->changed);
+    pthread_mutex_unlock(&queue->lock);
+}
+
+/*
+ * popFile() takes the first file node off a queue.
+ * 
+ * @param struct ingestQueue to take from
+ * @param bool wait as whether to wait for a file while the queue is empty and open
+ * 
+ * @return file node, or NULL if the queue is empty and either closed or not waited on
+ * 
+ */
+
+struct fileNode *popFile(struct ingestQueue *queue, bool wait)
+{
+    pthread_mutex_lock(&queue->lock);
+
+    while (wait && queue->head == NULL && !queue->closed)
+    {
+        pthread_cond_wait(&queue->changed, &queue->lock);
+    }
+
+    struct fileNode *filePtr = queue->head;
+
+    if (filePtr != NULL)
+    {
+        queue->head = filePtr->queueNext;
+        queue->size--;
+
+        if (queue->head == NULL)
+        {
+            queue->tail = NULL;
+        }
+
+        pthread_cond_broadcast(&queue->changed);
+    }
+
+    pthread_mutex_unlock(&queue->lock);
+
+    return filePtr;
+}
+
+/*
+ * ingestWorker() is the starting point of every blocking reading thread. It reads and
+ * tokenizes files off the file queue until the queue is closed.
+ * 
+ * @param struct args with the engine
+ * 
+ */
+
+void *ingestWorker(void *param)
+{
+    struct args *argsParam = (struct args *)param;
+    struct ingestEngine *engine = argsParam->ingest;
+    struct fileNode *filePtr;
+
+    while ((filePtr = popFile(&engine->files, true)) != NULL)
+    {
+        tokenize(filePtr);
+        finishFile(filePtr);
+        pushFile(&engine->merged, filePtr);
+    }
+
+    // Recording the CPU time of the thread for --stats
+
+    for (int t = 0; t < engine->numThreads; t++)
+    {
+        if (pthread_equal(engine->threads[t], pthread_self()))
+        {
+            engine->cpuTimes[t] = seconds(CLOCK_THREAD_CPUTIME_ID);
+        }
+    }
+
+    return 0;
+}
+
+/*
+ * tokenWorker() is the starting point of every tokenizing thread when the files are read
+ * by the ring. It tokenizes the buffers the ring thread has filled, or copies the words
+ * from the cache for files the ring thread found there, until the queue is closed.
+ * 
+ * @param struct args with the engine
+ * 
+ */
+
+void *tokenWorker(void *param)
+{
+    struct args *argsParam = (struct args *)param;
+    struct ingestEngine *engine = argsParam->ingest;
+    struct fileNode *filePtr;
+
+    while ((filePtr = popFile(&engine->buffers, true)) != NULL)
+    {
+        if (filePtr->cached)
+        {
+            if (!dedupFile(argsParam, filePtr, NULL, filePtr->size))
+            {
+                readCached(filePtr, filePtr->entry);
+            }
+        }
+        else if (filePtr->data != NULL)
+        {
+            if (!dedupFile(argsParam, filePtr, filePtr->data, filePtr->length))
+            {
+                iterate(filePtr, filePtr->data, filePtr->length);
+            }
+
+            free(filePtr->data);
+            filePtr->data = NULL;
+        }
+
+        finishFile(filePtr);
+        pushFile(&engine->merged, filePtr);
+    }
+
+    for (int t = 0; t < engine->numThreads; t++)
+    {
+        if (pthread_equal(engine->threads[t], pthread_self()))
+        {
+            engine->cpuTimes[t] = seconds(CLOCK_THREAD_CPUTIME_ID);
+        }
+    }
+
+    return 0;
+}
+
+/*
+ * mergeWorker() is the starting point of the merge thread. It merges the words of every
+ * tokenized file into the vocabulary with mergeFile() until the queue is closed.
+ * 
+ * @param struct args with the engine
+ * 
+ */
+
+void *mergeWorker(void *param)
+{
+    struct args *argsParam = (struct args *)param;
+    struct ingestEngine *engine = argsParam->ingest;
+    struct fileNode *filePtr;
+
+    while ((filePtr = popFile(&engine->merged, true)) != NULL)
+    {
+        mergeFile(argsParam, filePtr);
+    }
+
+    if (argsParam->stats != NULL)
+    {
+        engine->mergeCpuTime = seconds(CLOCK_THREAD_CPUTIME_ID);
+    }
+
+    return 0;
+}
+
+/*
+ * mergeFile() gives every word of a file a provisional id and replaces the file's words
+ * with an array of those ids, next to the array of their occurrence counts.
+ * 
+ * Provisional ids are handed out in the order the words are first seen, through
+ * mergeWord(), and the words themselves are kept in the vocabulary array. Since the file
+ * arrives in no particular order, the ids are only final once vocabulary() has
+ * renumbered them alphabetically. Only the words new to the vocabulary are copied, and
+ * the file's own words are freed here.
+ * 
+ * A file tokenized into feature ids by countFeatures() is looked up the same way, each id
+ * as its 16 hexadecimal digits, which sort in the same order as the ids.
+ * 
+ * @param struct args with the vocabulary and the engine
+ * @param struct fileNode with the words or the feature ids
+ * 
+ */
+
+void mergeFile(struct args *argsParam, struct fileNode *filePtr)
+{
+    if (filePtr->numWords == 0)
+    {
+        return;
+    }
+
+    filePtr->ids = (int *)malloc(sizeof(int) * filePtr->numWords);
+
+    if (filePtr->features != NULL)
+    {
+        for (int w = 0; w < filePtr->numWords; w++)
+        {
+            char digits[17];
+
+            snprintf(digits, sizeof(digits), "%016llx", (unsigned long long)filePtr->features[w]);
+            filePtr->ids[w] = mergeWord(argsParam, digits);
+        }
+
+        free(filePtr->features);
+        filePtr->features = NULL;
+
+        return;
+    }
+
+    const char *word = filePtr->words;
+
+    for (int w = 0; w < filePtr->numWords; w++)
+    {
+        filePtr->ids[w] = mergeWord(argsParam, word);
+        word += strlen(word) + 1;
+    }
+
+    free(filePtr->words);
+    filePtr->words = NULL;
+}
+
+/*
+ * mergeWord() finds the provisional id of a word in the merge table, or gives a new word
+ * the next one and adds a copy of it to the vocabulary.
+ * 
+ * @param struct args with the vocabulary and the engine
+ * @param const char *word as the word
+ * 
+ * @return provisional id of the word
+ * 
+ */
+
+int mergeWord(struct args *argsParam, const char *word)
+{
+    struct ingestEngine *engine = argsParam->ingest;
+    long slot = hashString(word, strlen(word)) & (engine->mergeTableSize - 1);
+
+    while (engine->mergeTable[slot] != -1 && strcmp(argsParam->vocab[engine->mergeTable[slot]], word) != 0)
+    {
+        slot = (slot + 1) & (engine->mergeTableSize - 1);
+    }
+
+    int id = engine->mergeTable[slot];
+
+    if (id != -1)
+    {
+        return id;
+    }
+
+    // A new word takes the next provisional id, and the table doubles once it is half full
+
+    id = argsParam->vocabSize;
+
+    if ((argsParam->vocabSize & (argsParam->vocabSize - 1)) == 0)
+    {
+        argsParam->vocab = (char **)realloc(argsParam->vocab, sizeof(char *) * (argsParam->vocabSize == 0 ? 1 : 2 * argsParam->vocabSize));
+    }
+
+    engine->mergeTable[slot] = id;
+    argsParam->vocab[argsParam->vocabSize++] = strdup(word);
+
+    if (2 * argsParam->vocabSize > engine->mergeTableSize)
+    {
+        free(engine->mergeTable);
+        engine->mergeTableSize *= 2;
+        engine->mergeTable = (int *)malloc(sizeof(int) * engine->mergeTableSize);
+
+        for (long t = 0; t < engine->mergeTableSize; t++)
+        {
+            engine->mergeTable[t] = -1;
+        }
+
+        for (long v = 0; v < argsParam->vocabSize; v++)
+        {
+            long rehash = hashString(argsParam->vocab[v], strlen(argsParam->vocab[v])) & (engine->mergeTableSize - 1);
+
+            while (engine->mergeTable[rehash] != -1)
+            {
+                rehash = (rehash + 1) & (engine->mergeTableSize - 1);
+            }
+
+            engine->mergeTable[rehash] = v;
+        }
+    }
+
+    return id;
+}
+
+#if defined(HAVE_IO_URING)
+
+/*
+ * setupRing() creates an io_uring ring of RING_DEPTH entries with the raw system calls
+ * and maps its submission queue, completion queue and submission entries.
+ * 
+ * Kernels before 5.6 can set up a ring but have no IORING_OP_READ, and would fail every
+ * read. The ring is only used if IORING_REGISTER_PROBE, which came in the same release,
+ * reports that the kernel supports the operation.
+ * 
+ * @param struct ingestEngine to set up the ring in
+ * 
+ * @return true if the ring is ready, false if the kernel does not allow io_uring reads
+ * 
+ */
+
+bool setupRing(struct ingestEngine *engine)
+{
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+
+    engine->ringFd = syscall(__NR_io_uring_setup, RING_DEPTH, &params);
+
+    if (engine->ringFd < 0)
+    {
+        return false;
+    }
+
+    // Asking the kernel which operations it supports, for every operation up to IORING_OP_READ
+
+    size_t probeLength = sizeof(struct io_uring_probe) + (IORING_OP_READ + 1) * sizeof(struct io_uring_probe_op);
+    struct io_uring_probe *probe = (struct io_uring_probe *)calloc(1, probeLength);
+    bool readable = (syscall(__NR_io_uring_register, engine->ringFd, IORING_REGISTER_PROBE, probe, IORING_OP_READ + 1) == 0 && probe->last_op >= IORING_OP_READ && (probe->ops[IORING_OP_READ].flags & IO_URING_OP_SUPPORTED));
+
+    free(probe);
+
+    if (!readable)
+    {
+        close(engine->ringFd);
+        return false;
+    }
+
+    engine->sqLength = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    engine->cqLength = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    engine->sqesLength = params.sq_entries * sizeof(struct io_uring_sqe);
+
+    // Older kernels map the two queues separately
+
+    if (params.features & IORING_FEAT_SINGLE_MMAP)
+    {
+        engine->sqLength = (engine->cqLength > engine->sqLength) ? engine->cqLength : engine->sqLength;
+        engine->cqLength = 0;
+    }
+
+    engine->sqRing = mmap(NULL, engine->sqLength, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, engine->ringFd, IORING_OFF_SQ_RING);
+    engine->cqRing = engine->sqRing;
+
+    if (engine->sqRing != MAP_FAILED && engine->cqLength > 0)
+    {
+        engine->cqRing = mmap(NULL, engine->cqLength, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, engine->ringFd, IORING_OFF_CQ_RING);
+    }
+
+    engine->sqes = mmap(NULL, engine->sqesLength, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, engine->ringFd, IORING_OFF_SQES);
+
+    if (engine->sqRing == MAP_FAILED || engine->cqRing == MAP_FAILED || engine->sqes == MAP_FAILED)
+    {
+        freeRing(engine);
+        return false;
+    }
+
+    engine->sqTail = (unsigned *)(engine->sqRing + params.sq_off.tail);
+    engine->sqMask = (unsigned *)(engine->sqRing + params.sq_off.ring_mask);
+    engine->sqArray = (unsigned *)(engine->sqRing + params.sq_off.array);
+    engine->cqHead = (unsigned *)(engine->cqRing + params.cq_off.head);
+    engine->cqTail = (unsigned *)(engine->cqRing + params.cq_off.tail);
+    engine->cqMask = (unsigned *)(engine->cqRing + params.cq_off.ring_mask);
+    engine->cqes = engine->cqRing + params.cq_off.cqes;
+
+    return true;
+}
+
+/*
+ * ringThread() is the starting point of the ring thread of --io-uring.
+ * 
+ * The thread takes files off the file queue, checks them with checkFile(), opens them and
+ * queues one read of the whole file for each, as long as fewer than RING_DEPTH files are
+ * being read or waiting to be tokenized. It then submits the reads and waits for at least
+ * one of them to complete in the same system call. Reads the kernel did not take, if the
+ * call was interrupted or only took some of them, stay queued and are submitted with the
+ * next call. A read that comes back short is queued again for the rest of the file. Finished files, along with files the cache
+ * already has and files that cannot be read, go onto the buffer queue for tokenWorker().
+ * 
+ * The thread only waits on the file queue while no read is in flight, and only waits for
+ * the tokenizing threads while no read is in flight and too many files are waiting.
+ * 
+ * @param struct args with the engine
+ * 
+ */
+
+void *ringThread(void *param)
+{
+    struct args *argsParam = (struct args *)param;
+    struct ingestEngine *engine = argsParam->ingest;
+    struct io_uring_sqe *sqes = (struct io_uring_sqe *)engine->sqes;
+    struct io_uring_cqe *cqes = (struct io_uring_cqe *)engine->cqes;
+
+    int inFlight = 0;
+    int toSubmit = 0;
+    bool closed = false;
+
+    while (!closed || inFlight > 0)
+    {
+        // Opening files and queueing their reads while there is room
+
+        while (!closed && inFlight < RING_DEPTH)
+        {
+            pthread_mutex_lock(&engine->buffers.lock);
+
+            while (inFlight == 0 && engine->buffers.size + inFlight >= RING_DEPTH)
+            {
+                pthread_cond_wait(&engine->buffers.changed, &engine->buffers.lock);
+            }
+
+            bool full = (engine->buffers.size + inFlight >= RING_DEPTH);
+            pthread_mutex_unlock(&engine->buffers.lock);
+
+            if (full)
+            {
+                break;
+            }
+
+            struct fileNode *filePtr = popFile(&engine->files, inFlight == 0);
+
+            if (filePtr == NULL)
+            {
+                pthread_mutex_lock(&engine->files.lock);
+                closed = engine->files.closed && engine->files.head == NULL;
+                pthread_mutex_unlock(&engine->files.lock);
+                break;
+            }
+
+            int fd = -1;
+
+            if (!checkFile(filePtr))
+            {
+                fd = openat(filePtr->dirFd, filePtr->fileName + filePtr->nameOffset, O_RDONLY);
+
+                if (fd == -1)
+                {
+                    printf("Error: File [%s] is not accessible, returning\n", filePtr->fileName);
+                }
+            }
+
+            if (fd == -1)
+            {
+                pushFile(&engine->buffers, filePtr);
+                continue;
+            }
+
+            struct ringRead *read = (struct ringRead *)malloc(sizeof(struct ringRead));
+            read->filePtr = filePtr;
+            read->fd = fd;
+            read->offset = 0;
+
+            filePtr->length = filePtr->statted ? filePtr->size : 0;
+            filePtr->data = (char *)malloc(filePtr->length + 1);
+
+            // Filling in the next submission entry and publishing it to the kernel
+
+            unsigned tail = *engine->sqTail;
+            unsigned slot = tail & *engine->sqMask;
+            struct io_uring_sqe *sqe = &sqes[slot];
+
+            memset(sqe, 0, sizeof(*sqe));
+            sqe->opcode = IORING_OP_READ;
+            sqe->fd = fd;
+            sqe->addr = (uint64_t)(uintptr_t)filePtr->data;
+            sqe->len = filePtr->length + 1;
+            sqe->off = 0;
+            sqe->user_data = (uint64_t)(uintptr_t)read;
+
+            engine->sqArray[slot] = slot;
+            __atomic_store_n(engine->sqTail, tail + 1, __ATOMIC_RELEASE);
+
+            inFlight++;
+            toSubmit++;
+        }
+
+        if (inFlight == 0)
+        {
+            continue;
+        }
+
+        // Submitting the new reads and waiting for at least one read to complete
+        // The reads the call did not take are still in the submission queue for the next call
+
+        long submitted = syscall(__NR_io_uring_enter, engine->ringFd, toSubmit, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+
+        if (submitted < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY)
+        {
+            printf("Error: io_uring failed, exiting\n");
+            exit(0);
+        }
+
+        if (submitted > 0)
+        {
+            toSubmit -= submitted;
+        }
+
+        // Handling every completed read
+
+        unsigned head = *engine->cqHead;
+        unsigned tail = __atomic_load_n(engine->cqTail, __ATOMIC_ACQUIRE);
+
+        while (head != tail)
+        {
+            struct io_uring_cqe *cqe = &cqes[head & *engine->cqMask];
+            struct ringRead *read = (struct ringRead *)(uintptr_t)cqe->user_data;
+            struct fileNode *filePtr = read->filePtr;
+            int result = cqe->res;
+
+            head++;
+
+            if (result > 0)
+            {
+                read->offset += result;
+
+                // Growing the buffer and reading on if the file filled it, since the file may have grown
+
+                if (read->offset == filePtr->length + 1)
+                {
+                    filePtr->length = 2 * filePtr->length + 1;
+                    filePtr->data = (char *)realloc(filePtr->data, filePtr->length + 1);
+                }
+
+                unsigned subTail = *engine->sqTail;
+                unsigned slot = subTail & *engine->sqMask;
+                struct io_uring_sqe *sqe = &sqes[slot];
+
+                memset(sqe, 0, sizeof(*sqe));
+                sqe->opcode = IORING_OP_READ;
+                sqe->fd = read->fd;
+                sqe->addr = (uint64_t)(uintptr_t)(filePtr->data + read->offset);
+                sqe->len = filePtr->length + 1 - read->offset;
+                sqe->off = read->offset;
+                sqe->user_data = (uint64_t)(uintptr_t)read;
+
+                engine->sqArray[slot] = slot;
+                __atomic_store_n(engine->sqTail, subTail + 1, __ATOMIC_RELEASE);
+                toSubmit++;
+
+                continue;
+            }
+
+            // The file is done, either at its end or with an error
+
+            if (result < 0)
+            {
+                printf("Error: File [%s] is not accessible, returning\n", filePtr->fileName);
+                free(filePtr->data);
+                filePtr->data = NULL;
+            }
+
+            filePtr->length = read->offset;
+            close(read->fd);
+            free(read);
+            inFlight--;
+
+            pushFile(&engine->buffers, filePtr);
+        }
+
+        __atomic_store_n(engine->cqHead, head, __ATOMIC_RELEASE);
+    }
+
+    if (argsParam->stats != NULL)
+    {
+        engine->ringCpuTime = seconds(CLOCK_THREAD_CPUTIME_ID);
+    }
+
+    return 0;
+}
+
+/*
+ * freeRing() unmaps the ring and closes it.
+ * 
+ * @param struct ingestEngine with the ring
+ * 
+ */
+
+void freeRing(struct ingestEngine *engine)
+{
+    if (engine->sqes != MAP_FAILED)
+    {
+        munmap(engine->sqes, engine->sqesLength);
+    }
+
+    if (engine->cqLength > 0 && engine->cqRing != MAP_FAILED)
+    {
+        munmap(engine->cqRing, engine->cqLength);
+    }
+
+    if (engine->sqRing != MAP_FAILED)
+    {
+        munmap(engine->sqRing, engine->sqLength);
+    }
+
+    close(engine->ringFd);
+}
+
+#else
+
+// Without io_uring headers, --io-uring always falls back to the blocking readers
+
+bool setupRing(struct ingestEngine *engine)
+{
+    return false;
+}
+
+void *ringThread(void *param)
+{
+    return 0;
+}
+
+void freeRing(struct ingestEngine *engine)
+{
+}
+
+#endif
+
+/*
+ * loadCache() loads the --cache file written by saveCache() on the last run.
+ * 
+ * The file starts with CACHE_MAGIC and CACHE_VERSION, followed by the number of entries
+ * and the featureKey() of the run, since the words of a file depend on --ngram and
+ * --features.
+ * Every entry holds the path, inode, size and modification time (seconds and nanoseconds)
+ * of one file, the hashContent() of its contents, its total number of tokens, and its
+ * words in alphabetical order, each as a length, the characters and the number of
+ * occurrences. The hash lets dedupFile() find duplicates among files it does not read. All numbers are stored in the
+ * machine's own byte order.
+ * 
+ * The whole file is read into memory once, and the entries point straight into it. A hash
+ * table from path to entry lets every tokenize() thread look up its file without locking,
+ * since nothing changes the cache after it is loaded. A missing cache is not an error, and
+ * a damaged one is ignored.
+ * 
+ * @param struct args with the cache path
+ * 
+ */
+
+void loadCache(struct args *argsParam)
+{
+    int fd = open(argsParam->cachePath, O_RDONLY);
+
+    if (fd == -1)
+    {
+        return;
+    }
+
+    struct stat info;
+
+    if (fstat(fd, &info) != 0)
+    {
+        close(fd);
+        return;
+    }
+
+    struct tokenCache *cache = (struct tokenCache *)malloc(sizeof(struct tokenCache));
+    cache->length = info.st_size;
+    cache->data = (unsigned char *)malloc(cache->length + 1);
+    cache->entries = NULL;
+    cache->numEntries = 0;
+    cache->table = NULL;
+    cache->tableSize = 0;
+
+    // Reading the whole file into memory
+
+    size_t done = 0;
+
+    while (done < cache->length)
+    {
+        ssize_t bytes = read(fd, cache->data + done, cache->length - done);
+
+        if (bytes <= 0)
+        {
+            break;
+        }
+
+        done += bytes;
+    }
+
+    close(fd);
+
+    // Checking the header, then walking every entry while making sure it fits in the file
+
+    size_t pos = strlen(CACHE_MAGIC) + sizeof(uint32_t) + 2 * sizeof(uint64_t);
+    bool valid = (done == cache->length && cache->length >= pos && memcmp(cache->data, CACHE_MAGIC, strlen(CACHE_MAGIC)) == 0);
+    uint32_t version = 0;
+    uint64_t numEntries = 0;
+    uint64_t features = 0;
+
+    if (valid)
+    {
+        memcpy(&version, cache->data + strlen(CACHE_MAGIC), sizeof(uint32_t));
+        memcpy(&numEntries, cache->data + strlen(CACHE_MAGIC) + sizeof(uint32_t), sizeof(uint64_t));
+        memcpy(&features, cache->data + strlen(CACHE_MAGIC) + sizeof(uint32_t) + sizeof(uint64_t), sizeof(uint64_t));
+
+        valid = (version == CACHE_VERSION && features == featureKey(argsParam) && numEntries <= cache->length);
+    }
+
+    if (valid)
+    {
+        cache->entries = (struct cacheEntry *)malloc(sizeof(struct cacheEntry) * (numEntries + 1));
+    }
+
+    for (uint64_t e = 0; valid && e < numEntries; e++)
+    {
+        struct cacheEntry *entry = &cache->entries[e];
+        size_t fixed = 5 * sizeof(uint64_t) + 2 * sizeof(uint32_t);
+
+        if (pos + sizeof(uint32_t) > cache->length)
+        {
+            valid = false;
+            break;
+        }
+
+        memcpy(&entry->pathLength, cache->data + pos, sizeof(uint32_t));
+        pos += sizeof(uint32_t);
+
+        if (entry->pathLength > cache->length - pos || fixed > cache->length - pos - entry->pathLength)
+        {
+            valid = false;
+            break;
+        }
+
+        entry->path = (const char *)cache->data + pos;
+        pos += entry->pathLength;
+
+        memcpy(&entry->inode, cache->data + pos, sizeof(uint64_t));
+        memcpy(&entry->size, cache->data + pos + 8, sizeof(uint64_t));
+        memcpy(&entry->mtimeSec, cache->data + pos + 16, sizeof(int64_t));
+        memcpy(&entry->mtimeNsec, cache->data + pos + 24, sizeof(int64_t));
+        memcpy(&entry->contentHash, cache->data + pos + 32, sizeof(uint64_t));
+        memcpy(&entry->total, cache->data + pos + 40, sizeof(uint32_t));
+        memcpy(&entry->numWords, cache->data + pos + 44, sizeof(uint32_t));
+        pos += 48;
+
+        entry->words = cache->data + pos;
+
+        for (uint32_t w = 0; w < entry->numWords; w++)
+        {
+            uint32_t wordLength;
+
+            if (pos + sizeof(uint32_t) > cache->length)
+            {
+                valid = false;
+                break;
+            }
+
+            memcpy(&wordLength, cache->data + pos, sizeof(uint32_t));
+
+            if (wordLength == 0 || wordLength > cache->length - pos - sizeof(uint32_t) || sizeof(uint32_t) > cache->length - pos - sizeof(uint32_t) - wordLength)
+            {
+                valid = false;
+                break;
+            }
+
+            pos += 2 * sizeof(uint32_t) + wordLength;
+        }
+
+        cache->numEntries++;
+    }
+
+    if (!valid)
+    {
+        printf("Error: Cache [%s] is not valid, ignoring\n", argsParam->cachePath);
+        freeCache(cache);
+        return;
+    }
+
+    // Building the hash table from path to entry, with at least twice as many slots as entries
+
+    cache->tableSize = 16;
+
+    while (cache->tableSize < 2 * cache->numEntries)
+    {
+        cache->tableSize *= 2;
+    }
+
+    cache->table = (long *)malloc(sizeof(long) * cache->tableSize);
+
+    for (long t = 0; t < cache->tableSize; t++)
+    {
+        cache->table[t] = -1;
+    }
+
+    for (long e = 0; e < cache->numEntries; e++)
+    {
+        long slot = hashString(cache->entries[e].path, cache->entries[e].pathLength) & (cache->tableSize - 1);
+
+        while (cache->table[slot] != -1)
+        {
+            slot = (slot + 1) & (cache->tableSize - 1);
+        }
+
+        cache->table[slot] = e;
+    }
+
+    argsParam->cache = cache;
+}
+
+/*
+ * lookupCache() finds the cache entry of a file, as long as the file still has the same
+ * inode, size and modification time as when the entry was saved.
+ * 
+ * @param struct tokenCache to search
+ * @param struct fileNode with the path and the values recorded by tokenize()
+ * 
+ * @return matching cache entry, or NULL if the file is new or has changed
+ * 
+ */
+
+struct cacheEntry *lookupCache(struct tokenCache *cache, struct fileNode *filePtr)
+{
+    size_t length = strlen(filePtr->fileName);
+    long slot = hashString(filePtr->fileName, length) & (cache->tableSize - 1);
+
+    while (cache->table[slot] != -1)
+    {
+        struct cacheEntry *entry = &cache->entries[cache->table[slot]];
+
+        if (entry->pathLength == length && memcmp(entry->path, filePtr->fileName, length) == 0)
+        {
+            if (entry->inode == filePtr->inode && entry->size == filePtr->size && entry->mtimeSec == filePtr->mtimeSec && entry->mtimeNsec == filePtr->mtimeNsec)
+            {
+                return entry;
+            }
+
+            return NULL;
+        }
+
+        slot = (slot + 1) & (cache->tableSize - 1);
+    }
+
+    return NULL;
+}
+
+/*
+ * readCached() fills a file node with the words of a cache entry, exactly as if iterate()
+ * had read the file. The words were saved in alphabetical order, so they are copied one
+ * after another into one block of text, each with its terminating null.
+ * 
+ * @param struct fileNode to fill in
+ * @param struct cacheEntry with the saved words
+ * 
+ */
+
+void readCached(struct fileNode *filePtr, struct cacheEntry *entry)
+{
+    const unsigned char *pos = entry->words;
+    size_t textLength = 0;
+
+    filePtr->total = entry->total;
+
+    if (entry->numWords == 0)
+    {
+        return;
+    }
+
+    // Measuring the words first, so they fit in one block
+
+    for (uint32_t w = 0; w < entry->numWords; w++)
+    {
+        uint32_t wordLength;
+
+        memcpy(&wordLength, pos, sizeof(uint32_t));
+        textLength += wordLength + 1;
+        pos += 2 * sizeof(uint32_t) + wordLength;
+    }
+
+    filePtr->words = (char *)malloc(sizeof(char) * textLength);
+    filePtr->counts = (float *)malloc(sizeof(float) * entry->numWords);
+    filePtr->numWords = entry->numWords;
+
+    char *text = filePtr->words;
+    pos = entry->words;
+
+    for (uint32_t w = 0; w < entry->numWords; w++)
+    {
+        uint32_t wordLength;
+        uint32_t count;
+
+        memcpy(&wordLength, pos, sizeof(uint32_t));
+        memcpy(&count, pos + sizeof(uint32_t) + wordLength, sizeof(uint32_t));
+
+        memcpy(text, pos + sizeof(uint32_t), wordLength);
+        text[wordLength] = '\0';
+        text += wordLength + 1;
+        filePtr->counts[w] = count;
+
+        pos += 2 * sizeof(uint32_t) + wordLength;
+    }
+}
+
+/*
+ * saveCache() writes the word counts of every file that was read successfully to the
+ * --cache file, in the format described in loadCache(), once vocabulary() has moved
+ * them into the shared word arrays.
+ * 
+ * The cache is written to a temporary file next to it first and then renamed over the
+ * old one, so a run that is interrupted never leaves a half written cache behind.
+ * 
+ * @param struct args with the file linked list and the cache path
+ * 
+ */
+
+void saveCache(struct args *argsParam)
+{
+    char *tempPath = (char *)malloc(sizeof(char) * (strlen(argsParam->cachePath) + 5));
+    strcpy(tempPath, argsParam->cachePath);
+    strcat(tempPath, ".tmp");
+
+    FILE *out = fopen(tempPath, "wb");
+
+    if (out == NULL)
+    {
+        printf("Error: Cache [%s] cannot be written, skipping\n", argsParam->cachePath);
+        free(tempPath);
+        return;
+    }
+
+    // Counting the files that can be matched on the next run
+
+    uint64_t numEntries = 0;
+    struct fileNode *filePtr = argsParam->fileHead;
+
+    while (filePtr != NULL)
+    {
+        if (!filePtr->folder && filePtr->statted)
+        {
+            numEntries++;
+        }
+
+        filePtr = filePtr->next;
+    }
+
+    uint32_t version = CACHE_VERSION;
+    uint64_t features = featureKey(argsParam);
+
+    fwrite(CACHE_MAGIC, 1, strlen(CACHE_MAGIC), out);
+    fwrite(&version, sizeof(uint32_t), 1, out);
+    fwrite(&numEntries, sizeof(uint64_t), 1, out);
+    fwrite(&features, sizeof(uint64_t), 1, out);
+
+    filePtr = argsParam->fileHead;
+
+    while (filePtr != NULL)
+    {
+        if (!filePtr->folder && filePtr->statted)
+        {
+            uint32_t pathLength = strlen(filePtr->fileName);
+            uint32_t total = filePtr->total;
+            uint32_t numWords = filePtr->numWords;
+
+            fwrite(&pathLength, sizeof(uint32_t), 1, out);
+            fwrite(filePtr->fileName, 1, pathLength, out);
+            fwrite(&filePtr->inode, sizeof(uint64_t), 1, out);
+            fwrite(&filePtr->size, sizeof(uint64_t), 1, out);
+            fwrite(&filePtr->mtimeSec, sizeof(int64_t), 1, out);
+            fwrite(&filePtr->mtimeNsec, sizeof(int64_t), 1, out);
+            fwrite(&filePtr->contentHash, sizeof(uint64_t), 1, out);
+            fwrite(&total, sizeof(uint32_t), 1, out);
+            fwrite(&numWords, sizeof(uint32_t), 1, out);
+
+            // The ids are in alphabetical order, so the words are saved alphabetically
+
+            for (uint32_t w = 0; w < numWords; w++)
+            {
+                const char *word = argsParam->vocab[filePtr->ids[w]];
+                uint32_t wordLength = strlen(word);
+                uint32_t count = filePtr->counts[w];
+
+                fwrite(&wordLength, sizeof(uint32_t), 1, out);
+                fwrite(word, 1, wordLength, out);
+                fwrite(&count, sizeof(uint32_t), 1, out);
+            }
+        }
+
+        filePtr = filePtr->next;
+    }
+
+    if (fclose(out) != 0 || rename(tempPath, argsParam->cachePath) != 0)
+    {
+        printf("Error: Cache [%s] cannot be written, skipping\n", argsParam->cachePath);
+        unlink(tempPath);
+    }
+
+    free(tempPath);
+}
+
+/*
+ * freeCache() frees a cache loaded by loadCache().
+ * 
+ * @param struct tokenCache to free
+ * 
+ */
+
+void freeCache(struct tokenCache *cache)
+{
+    free(cache->data);
+    free(cache->entries);
+    free(cache->table);
+    free(cache);
+}
+
+/*
+ * hashString() is the 64-bit FNV-1a hash of a string.
+ * 
+ * @param const char *string to hash
+ * @param size_t length of the string
+ * 
+ * @return hash of the string
+ * 
+ */
+
+uint64_t hashString(const char *string, size_t length)
+{
+    uint64_t hash = 0xCBF29CE484222325ULL;
+
+    for (size_t i = 0; i < length; i++)
+    {
+        hash ^= (unsigned char)string[i];
+        hash *= 0x100000001B3ULL;
+    }
+
+    return hash;
+}
+
+/*
+ * loadStore() maps the --store file written by saveStore() on the last runs.
+ * 
+ * The file starts with STORE_MAGIC, STORE_VERSION, the number of stored files N, and the
+ * featureKey() and --metric of the runs. It is followed by one row for every stored
+ * file, in the order the files were first stored. Row b starts with the file's entry:
+ * the path, padded to a multiple of 4 bytes, and the inode, size and modification time
+ * of the file. The entry is followed by one storeRecord (KLD1, KLD2, JSD and number of
+ * distinct words) for the pair of the file with every earlier file a < b, in order of a.
+ * 
+ * A file keeps the position of its row for good, so a run only appends the rows of
+ * new files at the end and rewrites the records of changed files in place (see
+ * saveStore()). Files are matched by path (see lookupStore()).
+ * 
+ * The file is memory-mapped, so only the records that are copied are ever read from disk.
+ * A missing store is not an error, and a damaged one is ignored.
+ * 
+ * @param struct args with the store path
+ * 
+ */
+
+void loadStore(struct args *argsParam)
+{
+    int fd = open(argsParam->storePath, O_RDONLY);
+
+    if (fd == -1)
+    {
+        return;
+    }
+
+    struct stat info;
+    size_t header = strlen(STORE_MAGIC) + 2 * sizeof(uint32_t) + 2 * sizeof(uint64_t);
+
+    if (fstat(fd, &info) != 0 || (size_t)info.st_size < header)
+    {
+        close(fd);
+        return;
+    }
+
+    unsigned char *map = (unsigned char *)mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (map == MAP_FAILED)
+    {
+        return;
+    }
+
+    struct pairStore *store = (struct pairStore *)malloc(sizeof(struct pairStore));
+    store->map = map;
+    store->length = info.st_size;
+    store->files = NULL;
+    store->table = NULL;
+    store->tableSize = 0;
+
+    uint32_t version = 0;
+    uint64_t features = 0;
+    uint32_t metric = 0;
+    memcpy(&version, map + strlen(STORE_MAGIC), sizeof(uint32_t));
+    memcpy(&store->numFiles, map + strlen(STORE_MAGIC) + sizeof(uint32_t), sizeof(uint64_t));
+    memcpy(&features, map + strlen(STORE_MAGIC) + sizeof(uint32_t) + sizeof(uint64_t), sizeof(uint64_t));
+    memcpy(&metric, map + strlen(STORE_MAGIC) + sizeof(uint32_t) + 2 * sizeof(uint64_t), sizeof(uint32_t));
+
+    bool valid = (memcmp(map, STORE_MAGIC, strlen(STORE_MAGIC)) == 0 && version == STORE_VERSION && features == featureKey(argsParam) && metric == (uint32_t)argsParam->metric && store->numFiles <= store->length);
+    size_t pos = header;
+
+    if (valid)
+    {
+        store->files = (struct storeFile *)malloc(sizeof(struct storeFile) * (store->numFiles + 1));
+    }
+
+    // Walking the rows while making sure every entry and its records fit in the file
+
+    for (uint64_t f = 0; valid && f < store->numFiles; f++)
+    {
+        struct storeFile *file = &store->files[f];
+
+        if (sizeof(uint32_t) > store->length - pos)
+        {
+            valid = false;
+            break;
+        }
+
+        memcpy(&file->pathLength, map + pos, sizeof(uint32_t));
+
+        if (file->pathLength > store->length || storeEntryLength(file->pathLength) > store->length - pos)
+        {
+            valid = false;
+            break;
+        }
+
+        file->offset = pos;
+        file->path = (const char *)map + pos + sizeof(uint32_t);
+        pos += storeEntryLength(file->pathLength);
+
+        memcpy(&file->inode, map + pos - 32, sizeof(uint64_t));
+        memcpy(&file->size, map + pos - 24, sizeof(uint64_t));
+        memcpy(&file->mtimeSec, map + pos - 16, sizeof(int64_t));
+        memcpy(&file->mtimeNsec, map + pos - 8, sizeof(int64_t));
+
+        if (f > (store->length - pos) / sizeof(struct storeRecord))
+        {
+            valid = false;
+            break;
+        }
+
+        file->records = (const struct storeRecord *)(map + pos);
+        pos += f * sizeof(struct storeRecord);
+    }
+
+    if (!valid)
+    {
+        printf("Error: Store [%s] is not valid, ignoring\n", argsParam->storePath);
+        freeStore(store);
+        return;
+    }
+
+    store->end = pos;
+
+    // Building the hash table from path to stored file, with at least twice as many slots as files
+
+    store->tableSize = 16;
+
+    while ((uint64_t)store->tableSize < 2 * store->numFiles)
+    {
+        store->tableSize *= 2;
+    }
+
+    store->table = (long *)malloc(sizeof(long) * store->tableSize);
+
+    for (long t = 0; t < store->tableSize; t++)
+    {
+        store->table[t] = -1;
+    }
+
+    for (uint64_t f = 0; f < store->numFiles; f++)
+    {
+        long slot = hashString(store->files[f].path, store->files[f].pathLength) & (store->tableSize - 1);
+
+        while (store->table[slot] != -1)
+        {
+            slot = (slot + 1) & (store->tableSize - 1);
+        }
+
+        store->table[slot] = f;
+    }
+
+    argsParam->store = store;
+}
+
+/*
+ * lookupStore() finds the stored index of a file, as long as the file still has the same
+ * inode, size and modification time as when it was stored.
+ * 
+ * @param struct pairStore to search
+ * @param struct fileNode with the path and the values recorded by tokenize()
+ * 
+ * @return stored index, or -1 if the file is new or has changed
+ * 
+ */
+
+long lookupStore(struct pairStore *store, struct fileNode *filePtr)
+{
+    long index = findStore(store, filePtr->fileName);
+
+    if (index == -1 || !filePtr->statted)
+    {
+        return -1;
+    }
+
+    struct storeFile *file = &store->files[index];
+
+    if (file->inode == filePtr->inode && file->size == filePtr->size && file->mtimeSec == filePtr->mtimeSec && file->mtimeNsec == filePtr->mtimeNsec)
+    {
+        return index;
+    }
+
+    return -1;
+}
+
+/*
+ * findStore() finds the stored index of a path, whether or not the file has changed
+ * since.
+ * 
+ * @param struct pairStore to search
+ * @param const char *path as the path of the file
+ * 
+ * @return stored index, or -1 if the path was never stored
+ * 
+ */
+
+long findStore(struct pairStore *store, const char *path)
+{
+    size_t length = strlen(path);
+    long slot = hashString(path, length) & (store->tableSize - 1);
+
+    while (store->table[slot] != -1)
+    {
+        struct storeFile *file = &store->files[store->table[slot]];
+
+        if (file->pathLength == length && memcmp(file->path, path, length) == 0)
+        {
+            return store->table[slot];
+        }
+
+        slot = (slot + 1) & (store->tableSize - 1);
+    }
+
+    return -1;
+}
+
+/*
+ * storeEntryLength() is the number of bytes of the entry of a stored file, before the
+ * records of its row: the path length, the path padded to a multiple of 4 bytes so the
+ * records stay aligned, and the inode, size and modification time.
+ * 
+ * @param uint32_t pathLength as the number of bytes in the path
+ * 
+ * @return number of bytes of the entry
+ * 
+ */
+
+size_t storeEntryLength(uint32_t pathLength)
+{
+    return sizeof(uint32_t) + (((size_t)pathLength + 3) & ~(size_t)3) + 4 * sizeof(uint64_t);
+}
+
+/*
+ * storedMean() builds the mean node of two stored files from their store record. The
+ * record keeps the divergences in the order of the stored indexes, so they are swapped
+ * when the files come in the other order this time.
+ * 
+ * @param struct pairTask with the files and their stored indexes
+ * @param int index1 and index2 as the positions of the files in the file array
+ * 
+ * @return mean node of the pair
+ * 
+ */
+
+struct meanNode storedMean(struct pairTask *task, int index1, int index2)
+{
+    long store1 = task->storeIndex[index1];
+    long store2 = task->storeIndex[index2];
+    long low = (store1 < store2) ? store1 : store2;
+    long high = (store1 < store2) ? store2 : store1;
+
+    const struct storeRecord *record = &task->stored[high].records[low];
+
+    struct meanNode newMean;
+    newMean.fileName1 = task->files[index1]->fileName;
+    newMean.fileName2 = task->files[index2]->fileName;
+    newMean.index1 = index1;
+    newMean.index2 = index2;
+    newMean.total = record->total;
+    newMean.KLD1 = (store1 < store2) ? record->KLD1 : record->KLD2;
+    newMean.KLD2 = (store1 < store2) ? record->KLD2 : record->KLD1;
+    newMean.JSD = record->JSD;
+
+    return newMean;
+}
+
+/*
+ * saveStore() writes the results of this run to the --store file, in the format described
+ * in loadStore().
+ * 
+ * Every file keeps the stored index of its path, and a new file gets the next index
+ * after the last stored one. Only the records of pairs that involve a new or changed
+ * file are written, from the mean array. The rows of new files are appended to the end
+ * of the file and the records of changed files are rewritten in place, so the records
+ * of unchanged pairs are never touched, and a run where nothing changed writes nothing.
+ * 
+ * A stored file that is not part of this run has no record with the new or changed
+ * files, so its entry is changed to never match again. If it comes back, it is compared
+ * as a changed file.
+ * 
+ * The store is written in an order that keeps it consistent if the run is interrupted:
+ * the records first, then the entries, and the number of files in the header last, so
+ * nothing is matched before its records are complete. A store that cannot be used is
+ * written again from scratch.
+ * 
+ * @param struct args with the file linked list, the mean array, the store and its path
+ * 
+ */
+
+void saveStore(struct args *argsParam)
+{
+    struct pairStore *store = argsParam->store;
+    int numFiles;
+    struct fileNode **files = collectFiles(argsParam, &numFiles);
+
+    // Giving every file its stored index, and laying out the rows of the new files after the stored ones
+
+    size_t header = strlen(STORE_MAGIC) + 2 * sizeof(uint32_t) + 2 * sizeof(uint64_t);
+    uint64_t oldFiles = (store == NULL) ? 0 : store->numFiles;
+    uint64_t storedFiles = oldFiles;
+    size_t length = (store == NULL) ? header : store->end;
+    long *indexes = (long *)malloc(sizeof(long) * (numFiles + 1));
+    bool *fresh = (bool *)malloc(sizeof(bool) * (numFiles + 1));
+    bool changed = (store == NULL);
+
+    for (int i = 0; i < numFiles; i++)
+    {
+        indexes[i] = (store == NULL) ? -1 : findStore(store, files[i]->fileName);
+        fresh[i] = (indexes[i] == -1 || lookupStore(store, files[i]) == -1);
+        changed |= fresh[i];
+
+        if (indexes[i] == -1)
+        {
+            indexes[i] = storedFiles++;
+            length += storeEntryLength(strlen(files[i]->fileName)) + indexes[i] * sizeof(struct storeRecord);
+        }
+    }
+
+    if (!changed)
+    {
+        free(indexes);
+        free(fresh);
+        free(files);
+        return;
+    }
+
+    int fd = open(argsParam->storePath, O_RDWR | O_CREAT | ((store == NULL) ? O_TRUNC : 0), 0644);
+    unsigned char *map = MAP_FAILED;
+
+    if (fd != -1 && ftruncate(fd, length) == 0)
+    {
+        map = (unsigned char *)mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+
+    if (map == MAP_FAILED)
+    {
+        printf("Error: Store [%s] cannot be written, skipping\n", argsParam->storePath);
+
+        if (fd != -1)
+        {
+            close(fd);
+        }
+
+        free(indexes);
+        free(fresh);
+        free(files);
+        return;
+    }
+
+    // Finding where the records of every row start, and writing the entries of the new rows
+
+    size_t *rows = (size_t *)malloc(sizeof(size_t) * (storedFiles + 1));
+    size_t pos = (store == NULL) ? header : store->end;
+
+    for (uint64_t f = 0; f < oldFiles; f++)
+    {
+        rows[f] = (const unsigned char *)store->files[f].records - store->map;
+    }
+
+    for (int i = 0; i < numFiles; i++)
+    {
+        if ((uint64_t)indexes[i] < oldFiles)
+        {
+            continue;
+        }
+
+        uint32_t pathLength = strlen(files[i]->fileName);
+
+        memset(map + pos, 0, storeEntryLength(pathLength));
+        memcpy(map + pos, &pathLength, sizeof(uint32_t));
+        memcpy(map + pos + sizeof(uint32_t), files[i]->fileName, pathLength);
+        pos += storeEntryLength(pathLength);
+        writeStoreStat(map + pos - 32, files[i]);
+
+        rows[indexes[i]] = pos;
+        pos += indexes[i] * sizeof(struct storeRecord);
+    }
+
+    // Filling in the record of every pair with a new or changed file, with the divergences in stored order
+
+    for (long m = 0; m < argsParam->numMeans; m++)
+    {
+        struct meanNode *mean = &argsParam->means[m];
+
+        if (mean->index1 == mean->index2 || (!fresh[mean->index1] && !fresh[mean->index2]))
+        {
+            continue;
+        }
+
+        long store1 = indexes[mean->index1];
+        long store2 = indexes[mean->index2];
+        long low = (store1 < store2) ? store1 : store2;
+        long high = (store1 < store2) ? store2 : store1;
+        struct storeRecord *record = (struct storeRecord *)(map + rows[high]) + low;
+
+        record->KLD1 = (store1 < store2) ? mean->KLD1 : mean->KLD2;
+        record->KLD2 = (store1 < store2) ? mean->KLD2 : mean->KLD1;
+        record->JSD = mean->JSD;
+        record->total = mean->total;
+    }
+
+    // Making the stored files that are not part of this run never match again, then updating the changed files
+
+    bool *present = (bool *)calloc(storedFiles + 1, sizeof(bool));
+
+    for (int i = 0; i < numFiles; i++)
+    {
+        present[indexes[i]] = true;
+    }
+
+    for (uint64_t f = 0; f < oldFiles; f++)
+    {
+        if (!present[f])
+        {
+            writeStoreStat(map + store->files[f].offset + storeEntryLength(store->files[f].pathLength) - 32, NULL);
+        }
+    }
+
+    for (int i = 0; i < numFiles; i++)
+    {
+        if (fresh[i] && (uint64_t)indexes[i] < oldFiles)
+        {
+            writeStoreStat(map + rows[indexes[i]] - 32, files[i]);
+        }
+    }
+
+    // Writing the header last, so the new rows only count once they are complete
+
+    uint32_t version = STORE_VERSION;
+    uint64_t features = featureKey(argsParam);
+    uint32_t metric = argsParam->metric;
+
+    memcpy(map, STORE_MAGIC, strlen(STORE_MAGIC));
+    memcpy(map + strlen(STORE_MAGIC), &version, sizeof(uint32_t));
+    memcpy(map + strlen(STORE_MAGIC) + sizeof(uint32_t) + sizeof(uint64_t), &features, sizeof(uint64_t));
+    memcpy(map + strlen(STORE_MAGIC) + sizeof(uint32_t) + 2 * sizeof(uint64_t), &metric, sizeof(uint32_t));
+    memcpy(map + strlen(STORE_MAGIC) + sizeof(uint32_t), &storedFiles, sizeof(uint64_t));
+
+    if (munmap(map, length) != 0 || close(fd) != 0)
+    {
+        printf("Error: Store [%s] cannot be written, skipping\n", argsParam->storePath);
+    }
+
+    free(present);
+    free(rows);
+    free(indexes);
+    free(fresh);
+    free(files);
+}
+
+/*
+ * writeStoreStat() writes the inode, size and modification time of a file into its store
+ * entry. A file that could not be checked, or no file at all, gets values that never
+ * match a file on the next run.
+ * 
+ * @param unsigned char *pos as the position of the values in the entry
+ * @param struct fileNode of the file, or NULL
+ * 
+ */
+
+void writeStoreStat(unsigned char *pos, struct fileNode *filePtr)
+{
+    bool statted = (filePtr != NULL && filePtr->statted);
+    uint64_t inode = statted ? filePtr->inode : 0;
+    uint64_t size = statted ? filePtr->size : 0;
+    int64_t mtimeSec = statted ? filePtr->mtimeSec : -1;
+    int64_t mtimeNsec = statted ? filePtr->mtimeNsec : -1;
+
+    memcpy(pos, &inode, sizeof(uint64_t));
+    memcpy(pos + 8, &size, sizeof(uint64_t));
+    memcpy(pos + 16, &mtimeSec, sizeof(int64_t));
+    memcpy(pos + 24, &mtimeNsec, sizeof(int64_t));
+}
+
+/*
+ * freeStore() unmaps and frees a store loaded by loadStore().
+ * 
+ * @param struct pairStore to free
+ * 
+ */
+
+void freeStore(struct pairStore *store)
+{
+    munmap(store->map, store->length);
+    free(store->files);
+    free(store->table);
+    free(store);
+}
+
+/*
+ * saveSnapshot() writes the files read from the base directory to one --snapshot file,
+ * so that later runs can compare them with --load without the directory.
+ * 
+ * The file starts with SNAPSHOT_MAGIC, SNAPSHOT_VERSION, the size of the vocabulary and
+ * the number of files. The vocabulary follows in id order, each word as a length and its
+ * characters with the null terminator, and then every file in the order of the sorted
+ * file linked list: the path (stored the same way), whether it could be checked, its
+ * inode, size and modification time, its total number of tokens, and its sparse count
+ * vector as the number of distinct words followed by an id and an occurrence count for
+ * each. All numbers are stored in the machine's own byte order.
+ * 
+ * The file is memory-mapped and written to a temporary file that is renamed over the old
+ * one at the end.
+ * 
+ * @param struct args with the sorted file linked list and the vocabulary
+ * @param char *snapshotPath as the file to write
+ * 
+ */
+
+void saveSnapshot(struct args *argsParam, char *snapshotPath)
+{
+    int numFiles;
+    struct fileNode **files = collectFiles(argsParam, &numFiles);
+
+    char *tempPath = (char *)malloc(sizeof(char) * (strlen(snapshotPath) + 5));
+    strcpy(tempPath, snapshotPath);
+    strcat(tempPath, ".tmp");
+
+    // Working out the size of the whole file
+
+    size_t header = strlen(SNAPSHOT_MAGIC) + sizeof(uint32_t) + 2 * sizeof(uint64_t);
+    size_t fileHeader = 1 + 4 * sizeof(uint64_t) + 2 * sizeof(uint32_t);
+    size_t length = header;
+
+    for (int v = 0; v < argsParam->vocabSize; v++)
+    {
+        length += sizeof(uint32_t) + strlen(argsParam->vocab[v]) + 1;
+    }
+
+    for (int i = 0; i < numFiles; i++)
+    {
+        length += sizeof(uint32_t) + strlen(files[i]->fileName) + 1 + fileHeader;
+        length += (size_t)files[i]->numWords * (sizeof(uint32_t) + sizeof(float));
+    }
+
+    int fd = open(tempPath, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    unsigned char *map = MAP_FAILED;
+
+    if (fd != -1 && ftruncate(fd, length) == 0)
+    {
+        map = (unsigned char *)mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+
+    if (map == MAP_FAILED)
+    {
+        printf("Error: Snapshot [%s] cannot be written, exiting\n", snapshotPath);
+        exit(0);
+    }
+
+    uint32_t version = SNAPSHOT_VERSION;
+    uint64_t vocabSize = argsParam->vocabSize;
+    uint64_t storedFiles = numFiles;
+    size_t pos = strlen(SNAPSHOT_MAGIC);
+
+    memcpy(map, SNAPSHOT_MAGIC, pos);
+    memcpy(map + pos, &version, sizeof(uint32_t));
+    memcpy(map + pos + sizeof(uint32_t), &vocabSize, sizeof(uint64_t));
+    memcpy(map + pos + sizeof(uint32_t) + sizeof(uint64_t), &storedFiles, sizeof(uint64_t));
+    pos = header;
+
+    // Writing the vocabulary in id order
+
+    for (int v = 0; v < argsParam->vocabSize; v++)
+    {
+        uint32_t wordLength = strlen(argsParam->vocab[v]);
+
+        memcpy(map + pos, &wordLength, sizeof(uint32_t));
+        memcpy(map + pos + sizeof(uint32_t), argsParam->vocab[v], wordLength + 1);
+        pos += sizeof(uint32_t) + wordLength + 1;
+    }
+
+    // Writing every file with its count vector, which is already in id order
+
+    for (int i = 0; i < numFiles; i++)
+    {
+        struct fileNode *filePtr = files[i];
+        uint32_t pathLength = strlen(filePtr->fileName);
+        uint8_t statted = filePtr->statted;
+        uint64_t inode = filePtr->statted ? filePtr->inode : 0;
+        uint64_t size = filePtr->statted ? filePtr->size : 0;
+        int64_t mtimeSec = filePtr->statted ? filePtr->mtimeSec : -1;
+        int64_t mtimeNsec = filePtr->statted ? filePtr->mtimeNsec : -1;
+        uint32_t total = filePtr->total;
+        uint32_t numWords = filePtr->numWords;
+
+        memcpy(map + pos, &pathLength, sizeof(uint32_t));
+        memcpy(map + pos + sizeof(uint32_t), filePtr->fileName, pathLength + 1);
+        pos += sizeof(uint32_t) + pathLength + 1;
+
+        map[pos] = statted;
+        memcpy(map + pos + 1, &inode, sizeof(uint64_t));
+        memcpy(map + pos + 9, &size, sizeof(uint64_t));
+        memcpy(map + pos + 17, &mtimeSec, sizeof(int64_t));
+        memcpy(map + pos + 25, &mtimeNsec, sizeof(int64_t));
+        memcpy(map + pos + 33, &total, sizeof(uint32_t));
+        memcpy(map + pos + 37, &numWords, sizeof(uint32_t));
+        pos += fileHeader;
+
+        for (int w = 0; w < filePtr->numWords; w++)
+        {
+            uint32_t id = filePtr->ids[w];
+
+            memcpy(map + pos, &id, sizeof(uint32_t));
+            memcpy(map + pos + sizeof(uint32_t), &filePtr->counts[w], sizeof(float));
+            pos += sizeof(uint32_t) + sizeof(float);
+        }
+    }
+
+    if (munmap(map, length) != 0 || close(fd) != 0 || rename(tempPath, snapshotPath) != 0)
+    {
+        printf("Error: Snapshot [%s] cannot be written, exiting\n", snapshotPath);
+        unlink(tempPath);
+        exit(0);
+    }
+
+    free(tempPath);
+    free(files);
+}
+
+/*
+ * loadSnapshot() maps a --snapshot file written by saveSnapshot() and builds the file
+ * linked list, the vocabulary and the shared word arrays from it, in place of
+ * readDirectory() and vocabulary().
+ * 
+ * The vocabulary points straight into the mapping, which stays mapped until freeing().
+ * The files come out already sorted, so they are not sorted again. Unlike the cache and
+ * the store, the snapshot is the only input of the run, so a snapshot that cannot be read
+ * is an error.
+ * 
+ * @param struct args to fill in
+ * @param char *loadPath as the file to read
+ * 
+ */
+
+void loadSnapshot(struct args *argsParam, char *loadPath)
+{
+    int fd = open(loadPath, O_RDONLY);
+    struct stat info;
+
+    if (fd == -1 || fstat(fd, &info) != 0)
+    {
+        printf("Error: Snapshot [%s] cannot be opened, exiting\n", loadPath);
+        exit(0);
+    }
+
+    size_t length = info.st_size;
+    size_t header = strlen(SNAPSHOT_MAGIC) + sizeof(uint32_t) + 2 * sizeof(uint64_t);
+    size_t fileHeader = 1 + 4 * sizeof(uint64_t) + 2 * sizeof(uint32_t);
+    unsigned char *map = (length < header) ? MAP_FAILED : (unsigned char *)mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (map == MAP_FAILED)
+    {
+        printf("Error: Snapshot [%s] is not valid, exiting\n", loadPath);
+        exit(0);
+    }
+
+    argsParam->snapshot = map;
+    argsParam->snapshotLength = length;
+
+    uint32_t version = 0;
+    uint64_t vocabSize = 0;
+    uint64_t numFiles = 0;
+    size_t pos = strlen(SNAPSHOT_MAGIC);
+
+    memcpy(&version, map + pos, sizeof(uint32_t));
+    memcpy(&vocabSize, map + pos + sizeof(uint32_t), sizeof(uint64_t));
+    memcpy(&numFiles, map + pos + sizeof(uint32_t) + sizeof(uint64_t), sizeof(uint64_t));
+    pos = header;
+
+    // Every word and file takes at least four bytes, which bounds both counts by the length
+
+    bool valid = (memcmp(map, SNAPSHOT_MAGIC, strlen(SNAPSHOT_MAGIC)) == 0 && version == SNAPSHOT_VERSION && vocabSize <= length / sizeof(uint32_t) && numFiles <= length / sizeof(uint32_t));
+
+    // Pointing the vocabulary at the words in the mapping
+
+    argsParam->vocab = (char **)malloc(sizeof(char *) * (valid ? vocabSize + 1 : 1));
+
+    for (uint64_t v = 0; valid && v < vocabSize; v++)
+    {
+        uint32_t wordLength;
+
+        if (sizeof(uint32_t) > length - pos)
+        {
+            valid = false;
+            break;
+        }
+
+        memcpy(&wordLength, map + pos, sizeof(uint32_t));
+        pos += sizeof(uint32_t);
+
+        if ((size_t)wordLength + 1 > length - pos || map[pos + wordLength] != '\0')
+        {
+            valid = false;
+            break;
+        }
+
+        argsParam->vocab[argsParam->vocabSize++] = (char *)map + pos;
+        pos += wordLength + 1;
+    }
+
+    // Building a file node for every file, with its words appended to the shared arrays
+    // Every word takes 8 bytes of the file, which bounds the size of the arrays until they are trimmed
+
+    struct fileNode *tail = NULL;
+    long numEntries = 0;
+    size_t maxEntries = valid ? (length - pos) / (sizeof(uint32_t) + sizeof(float)) : 0;
+
+    argsParam->wordIds = (int *)malloc(sizeof(int) * (maxEntries + 1));
+    argsParam->wordCounts = (float *)malloc(sizeof(float) * (maxEntries + 1));
+
+    for (uint64_t f = 0; valid && f < numFiles; f++)
+    {
+        uint32_t pathLength;
+        uint32_t total;
+        uint32_t numWords;
+
+        if (sizeof(uint32_t) > length - pos)
+        {
+            valid = false;
+            break;
+        }
+
+        memcpy(&pathLength, map + pos, sizeof(uint32_t));
+        pos += sizeof(uint32_t);
+
+        if ((size_t)pathLength + 1 > length - pos || fileHeader > length - pos - pathLength - 1)
+        {
+            valid = false;
+            break;
+        }
+
+        struct fileNode *newFile = (struct fileNode *)malloc(sizeof(struct fileNode));
+        newFile->fileName = (char *)malloc(sizeof(char) * (pathLength + 1));
+        memcpy(newFile->fileName, map + pos, pathLength);
+        newFile->fileName[pathLength] = '\0';
+        pos += pathLength + 1;
+
+        newFile->statted = (map[pos] != 0);
+        memcpy(&newFile->inode, map + pos + 1, sizeof(uint64_t));
+        memcpy(&newFile->size, map + pos + 9, sizeof(uint64_t));
+        memcpy(&newFile->mtimeSec, map + pos + 17, sizeof(int64_t));
+        memcpy(&newFile->mtimeNsec, map + pos + 25, sizeof(int64_t));
+        memcpy(&total, map + pos + 33, sizeof(uint32_t));
+        memcpy(&numWords, map + pos + 37, sizeof(uint32_t));
+        pos += fileHeader;
+
+        newFile->total = total;
+        newFile->numWords = 0;
+        newFile->threaded = false;
+        newFile->nameOffset = 0;
+        newFile->dirFd = -1;
+        newFile->depth = 0;
+        newFile->folder = false;
+        newFile->cached = false;
+        newFile->cpuTime = 0;
+        newFile->argsParam = argsParam;
+        newFile->children.head = NULL;
+        newFile->children.tail = NULL;
+        newFile->words = NULL;
+        newFile->ids = NULL;
+        newFile->counts = NULL;
+        newFile->features = NULL;
+        newFile->wordStart = numEntries;
+        newFile->wait = NULL;
+        newFile->entry = NULL;
+        newFile->contentHash = 0;
+        newFile->original = NULL;
+        newFile->group = 0;
+        newFile->data = NULL;
+        newFile->length = 0;
+        newFile->queueNext = NULL;
+        newFile->next = NULL;
+
+        if (tail == NULL)
+        {
+            argsParam->fileHead = newFile;
+        }
+        else
+        {
+            tail->next = newFile;
+        }
+
+        tail = newFile;
+
+        if (numWords > (length - pos) / (sizeof(uint32_t) + sizeof(float)))
+        {
+            valid = false;
+            break;
+        }
+
+        for (uint32_t w = 0; w < numWords; w++)
+        {
+            uint32_t id;
+            float occurrence;
+
+            memcpy(&id, map + pos, sizeof(uint32_t));
+            memcpy(&occurrence, map + pos + sizeof(uint32_t), sizeof(float));
+            pos += sizeof(uint32_t) + sizeof(float);
+
+            if (id >= vocabSize || total == 0)
+            {
+                valid = false;
+                break;
+            }
+
+            argsParam->wordIds[numEntries] = id;
+            argsParam->wordCounts[numEntries] = occurrence;
+            numEntries++;
+            newFile->numWords++;
+        }
+    }
+
+    if (!valid)
+    {
+        printf("Error: Snapshot [%s] is not valid, exiting\n", loadPath);
+        exit(0);
+    }
+
+    if (argsParam->fileHead == NULL)
+    {
+        printf("Error: No data, exiting\n");
+        exit(0);
+    }
+
+    argsParam->wordIds = (int *)realloc(argsParam->wordIds, sizeof(int) * (numEntries + 1));
+    argsParam->wordCounts = (float *)realloc(argsParam->wordCounts, sizeof(float) * (numEntries + 1));
+    argsParam->numEntries = numEntries + 1;
+
+    // Moving the word arrays out to temporary files under --mem-limit
+
+    if (argsParam->memLimit > 0)
+    {
+        int *wordIds = (int *)spillAlloc(argsParam, sizeof(int) * argsParam->numEntries);
+        float *wordCounts = (float *)spillAlloc(argsParam, sizeof(float) * argsParam->numEntries);
+
+        memcpy(wordIds, argsParam->wordIds, sizeof(int) * argsParam->numEntries);
+        memcpy(wordCounts, argsParam->wordCounts, sizeof(float) * argsParam->numEntries);
+        free(argsParam->wordIds);
+        free(argsParam->wordCounts);
+
+        argsParam->wordIds = wordIds;
+        argsParam->wordCounts = wordCounts;
+    }
+
+    placeWords(argsParam);
+}
+
+/*
+ * iterate() goes through the contents of a file in memory, token by token. The function
+ * only counts alphabetical characters and dashes (-) as valid characters.
+ * 
+ * The contents are read as UTF-8. A valid character is a letter or a mark of any script,
+ * or a dash, and whitespace includes the Unicode spaces. Bytes that are not valid UTF-8
+ * are skipped like any other character that is not valid.
+ * 
+ * A token runs up to the next whitespace. The function finds where it ends with
+ * scanKernel(), which also tells whether every character of the token is an ASCII letter
+ * or a dash, as it is for almost every English word. Such a token is copied in lowercase
+ * with lowerKernel(), many characters at a time. Any other token is decoded and folded
+ * to lowercase one code point at a time by foldToken(). Every token is folded into the
+ * same buffer, and then counted by addWord() in a hash table of the file's own, so only
+ * the distinct words of the file are ever copied. Once the whole file is read,
+ * finishWords() sorts them. Tokens without valid characters are skipped.
+ * 
+ * With --ngram or --features, the tokens are not counted themselves. Each one is hashed
+ * with hashString(), every run of --ngram tokens in a row becomes one 64-bit feature id
+ * with shingleId(), and the ids of the whole file are counted at once by countFeatures().
+ * 
+ * @param struct fileNode as a pointer to the next fileNode
+ * @param const char *data as the contents of the file
+ * @param size_t length as the number of bytes in the contents
+ * 
+ */
+
+void iterate(struct fileNode *filePtr, const char *data, size_t length)
+{
+    struct args *argsParam = filePtr->argsParam;
+    uint64_t window[NGRAM_MAX];
+    long seen = 0;
+    uint64_t *features = NULL;
+    long numFeatures = 0;
+    long capacity = 0;
+    struct wordTable table;
+    char *newTok = NULL;
+    size_t tokCapacity = 0;
+    size_t pos = 0;
+
+    table.numSlots = 0;
+
+    while (pos < length)
+    {
+        // Skipping the whitespace before the token
+
+        pos = skipSpace(data, pos, length);
+
+        if (pos == length)
+        {
+            break;
+        }
+
+        // Finds the end of the current token
+
+        size_t start = pos;
+        bool clean = true;
+
+        pos = scanKernel(data, pos, length, &clean);
+
+        size_t valid = pos - start;
+
+        if (!clean)
+        {
+            // Measuring the folded token first, since it can end before a Unicode space inside what was scanned
+
+            pos = foldToken(data, start, length, NULL, &valid);
+
+            if (valid == 0)
+            {
+                // If the token has no valid characters, nothing will happen
+
+                continue;
+            }
+        }
+
+        // Every token of the file is written to the same buffer, which only grows for a longer token
+
+        if (valid + 1 > tokCapacity)
+        {
+            tokCapacity = (2 * tokCapacity > valid + 1) ? 2 * tokCapacity : valid + 1;
+            newTok = (char *)realloc(newTok, sizeof(char) * tokCapacity);
+        }
+
+        if (clean)
+        {
+            lowerKernel(newTok, data + start, valid);
+        }
+        else
+        {
+            foldToken(data, start, length, newTok, &valid);
+        }
+
+        newTok[valid] = '\0';
+
+        if (argsParam->ngram == 1 && argsParam->featureDims == 0)
+        {
+            filePtr->total++;
+            addWord(&table, newTok, valid);
+            continue;
+        }
+
+        // Keeping only the hash of the word for the shingles it is part of
+
+        window[seen % argsParam->ngram] = hashString(newTok, valid);
+        seen++;
+
+        if (seen < argsParam->ngram)
+        {
+            continue;
+        }
+
+        if (numFeatures == capacity)
+        {
+            capacity = (capacity == 0) ? 1024 : 2 * capacity;
+            features = (uint64_t *)realloc(features, sizeof(uint64_t) * capacity);
+        }
+
+        features[numFeatures++] = shingleId(argsParam, window, seen, argsParam->ngram);
+    }
+
+    free(newTok);
+
+    if (table.numSlots > 0)
+    {
+        finishWords(filePtr, &table);
+    }
+
+    // A file shorter than one shingle still gets a single feature from all of its words
+
+    if (seen > 0 && seen < argsParam->ngram)
+    {
+        features = (uint64_t *)malloc(sizeof(uint64_t));
+        features[numFeatures++] = shingleId(argsParam, window, seen, seen);
+    }
+
+    if (features != NULL)
+    {
+        countFeatures(filePtr, features, numFeatures);
+    }
+}
+
+/*
+ * addWord() counts a token of a file in the file's word table. If the table already
+ * contains the token, the count of the matching word is incremented. Otherwise the token
+ * is copied to the end of the table's text and counted once.
+ * 
+ * The table is an open addressing hash table of the distinct words, and the words
+ * themselves are kept one after another in a single block of text, so a token that was
+ * already seen costs one hash and one comparison and no allocation at all.
+ * 
+ * @param struct wordTable of the file
+ * @param const char *newTok as the token
+ * @param size_t length as the number of bytes in the token
+ * 
+ */
+
+void addWord(struct wordTable *table, const char *newTok, size_t length)
+{
+    if (table->numSlots == 0)
+    {
+        // Setting the table up for the first word of the file
+
+        table->text = NULL;
+        table->textLength = 0;
+        table->textCapacity = 0;
+        table->offsets = NULL;
+        table->counts = NULL;
+        table->numWords = 0;
+        table->capacity = 0;
+        table->slots = NULL;
+        growWords(table);
+    }
+
+    long slot = hashString(newTok, length) & (table->numSlots - 1);
+
+    while (table->slots[slot] != -1)
+    {
+        const char *word = table->text + table->offsets[table->slots[slot]];
+
+        if (strncmp(word, newTok, length) == 0 && word[length] == '\0')
+        {
+            table->counts[table->slots[slot]]++;
+            return;
+        }
+
+        slot = (slot + 1) & (table->numSlots - 1);
+    }
+
+    // Adding the new word to the end of the text and of the arrays, which double when full
+
+    if (table->textLength + length + 1 > table->textCapacity)
+    {
+        table->textCapacity = (2 * table->textCapacity > table->textLength + length + 1) ? 2 * table->textCapacity : table->textLength + length + 1;
+        table->text = (char *)realloc(table->text, sizeof(char) * table->textCapacity);
+    }
+
+    if (table->numWords == table->capacity)
+    {
+        table->capacity = (table->capacity == 0) ? 256 : 2 * table->capacity;
+        table->offsets = (size_t *)realloc(table->offsets, sizeof(size_t) * table->capacity);
+        table->counts = (float *)realloc(table->counts, sizeof(float) * table->capacity);
+    }
+
+    memcpy(table->text + table->textLength, newTok, length);
+    table->text[table->textLength + length] = '\0';
+    table->offsets[table->numWords] = table->textLength;
+    table->counts[table->numWords] = 1;
+    table->slots[slot] = table->numWords;
+    table->textLength += length + 1;
+    table->numWords++;
+
+    if (2 * table->numWords > table->numSlots)
+    {
+        growWords(table);
+    }
+}
+
+/*
+ * growWords() doubles the hash table of a word table, or gives an empty one its first
+ * slots, and puts every word back in.
+ * 
+ * @param struct wordTable to grow
+ * 
+ */
+
+void growWords(struct wordTable *table)
+{
+    free(table->slots);
+    table->numSlots = (table->numSlots == 0) ? 512 : 2 * table->numSlots;
+    table->slots = (int *)malloc(sizeof(int) * table->numSlots);
+
+    for (long t = 0; t < table->numSlots; t++)
+    {
+        table->slots[t] = -1;
+    }
+
+    for (int w = 0; w < table->numWords; w++)
+    {
+        const char *word = table->text + table->offsets[w];
+        long rehash = hashString(word, strlen(word)) & (table->numSlots - 1);
+
+        while (table->slots[rehash] != -1)
+        {
+            rehash = (rehash + 1) & (table->numSlots - 1);
+        }
+
+        table->slots[rehash] = w;
+    }
+}
+
+/*
+ * finishWords() sorts the distinct words of a file alphabetically once the whole file
+ * has been counted, and moves them into the file node as one block of text, each word
+ * followed by its terminating null, with their counts in the same order. The word table
+ * is freed.
+ * 
+ * @param struct fileNode of the file
+ * @param struct wordTable with the words of the file
+ * 
+ */
+
+void finishWords(struct fileNode *filePtr, struct wordTable *table)
+{
+    struct wordNode *words = (struct wordNode *)malloc(sizeof(struct wordNode) * table->numWords);
+    struct wordNode **nodes = (struct wordNode **)malloc(sizeof(struct wordNode *) * table->numWords);
+
+    for (int w = 0; w < table->numWords; w++)
+    {
+        words[w].word = table->text + table->offsets[w];
+        words[w].occurrence = table->counts[w];
+        nodes[w] = &words[w];
+    }
+
+    qsort(nodes, table->numWords, sizeof(struct wordNode *), compareWords);
+
+    filePtr->words = (char *)malloc(sizeof(char) * table->textLength);
+    filePtr->counts = (float *)malloc(sizeof(float) * table->numWords);
+    filePtr->numWords = table->numWords;
+
+    char *text = filePtr->words;
+
+    for (int w = 0; w < table->numWords; w++)
+    {
+        size_t wordLength = strlen(nodes[w]->word) + 1;
+
+        memcpy(text, nodes[w]->word, wordLength);
+        text += wordLength;
+        filePtr->counts[w] = nodes[w]->occurrence;
+    }
+
+    free(nodes);
+    free(words);
+    free(table->text);
+    free(table->offsets);
+    free(table->counts);
+    free(table->slots);
+}
+
+/*
+ * shingleId() is the feature id of the shingle made of the last count words of a file.
+ * The hashes of the words are combined in order with mix64(), and hashed down to one of
+ * --features values when there is a limit.
+ * 
+ * @param struct args with the settings
+ * @param const uint64_t *window as the hashes of the last --ngram words, by position modulo --ngram
+ * @param long seen as the number of words of the file so far
+ * @param int count as the number of words in the shingle
+ * 
+ * @return feature id
+ * 
+ */
+
+uint64_t shingleId(struct args *argsParam, const uint64_t *window, long seen, int count)
+{
+    uint64_t feature = 0;
+
+    for (long w = seen - count; w < seen; w++)
+    {
+        feature = mix64(feature ^ window[w % argsParam->ngram]);
+    }
+
+    if (argsParam->featureDims > 0)
+    {
+        feature %= argsParam->featureDims;
+    }
+
+    return feature;
+}
+
+/*
+ * countFeatures() turns every feature id of a file into its distinct ids and their
+ * counts, by sorting the ids and counting the runs of equal ones. The distinct ids are
+ * kept in the file node's feature array and the counts in its count array, until
+ * mergeFile() gives them vocabulary ids. This costs O(n log n) for n features, however
+ * many of them are distinct.
+ * 
+ * @param struct fileNode of the file
+ * @param uint64_t *features as every feature id of the file, which the file takes ownership of
+ * @param long numFeatures as the number of feature ids
+ * 
+ */
+
+void countFeatures(struct fileNode *filePtr, uint64_t *features, long numFeatures)
+{
+    qsort(features, numFeatures, sizeof(uint64_t), compareFeatures);
+
+    filePtr->counts = (float *)malloc(sizeof(float) * numFeatures);
+    filePtr->total = numFeatures;
+
+    int distinct = 0;
+
+    for (long f = 0; f < numFeatures; f++)
+    {
+        if (distinct > 0 && features[distinct - 1] == features[f])
+        {
+            filePtr->counts[distinct - 1]++;
+            continue;
+        }
+
+        features[distinct] = features[f];
+        filePtr->counts[distinct] = 1;
+        distinct++;
+    }
+
+    filePtr->features = features;
+    filePtr->numWords = distinct;
+}
+
+/*
+ * compareFeatures() is the qsort() comparator of countFeatures(), in increasing order of
+ * feature id.
+ * 
+ */
+
+int compareFeatures(const void *a, const void *b)
+{
+    uint64_t feature1 = *(const uint64_t *)a;
+    uint64_t feature2 = *(const uint64_t *)b;
+
+    return (feature1 > feature2) - (feature1 < feature2);
+}
+
+/*
+ * featureKey() packs the --ngram and --features settings into one number, which the
+ * --cache and --store files are written with, so that they are only reused with the
+ * same features.
+ * 
+ * @param struct args with the settings
+ * 
+ * @return --ngram in the upper 32 bits and --features in the lower ones
+ * 
+ */
+
+uint64_t featureKey(struct args *argsParam)
+{
+    return ((uint64_t)argsParam->ngram << 32) | argsParam->featureDims;
+}
+
+// Code points from U+0080 up that count as valid characters of a word, the letters and marks
+// (general categories L and M), as ranges sorted by first code point. Generated from the
+// Unicode 14.0.0 character database.
+
+static const uint32_t letterRanges[][2] = {
+    {0x00AA, 0x00AA}, {0x00B5, 0x00B5}, {0x00BA, 0x00BA}, {0x00C0, 0x00D6}, {0x00D8, 0x00F6},
+    {0x00F8, 0x02C1}, {0x02C6, 0x02D1}, {0x02E0, 0x02E4}, {0x02EC, 0x02EC}, {0x02EE, 0x02EE},
+    {0x0300, 0x0374}, {0x0376, 0x0377}, {0x037A, 0x037D}, {0x037F, 0x037F}, {0x0386, 0x0386},
+    {0x0388, 0x038A}, {0x038C, 0x038C}, {0x038E, 0x03A1}, {0x03A3, 0x03F5}, {0x03F7, 0x0481},
+    {0x0483, 0x052F}, {0x0531, 0x0556}, {0x0559, 0x0559}, {0x0560, 0x0588}, {0x0591, 0x05BD},
+    {0x05BF, 0x05BF}, {0x05C1, 0x05C2}, {0x05C4, 0x05C5}, {0x05C7, 0x05C7}, {0x05D0, 0x05EA},
+    {0x05EF, 0x05F2}, {0x0610, 0x061A}, {0x0620, 0x065F}, {0x066E, 0x06D3}, {0x06D5, 0x06DC},
+    {0x06DF, 0x06E8}, {0x06EA, 0x06EF}, {0x06FA, 0x06FC}, {0x06FF, 0x06FF}, {0x0710, 0x074A},
+    {0x074D, 0x07B1}, {0x07CA, 0x07F5}, {0x07FA, 0x07FA}, {0x07FD, 0x07FD}, {0x0800, 0x082D},
+    {0x0840, 0x085B}, {0x0860, 0x086A}, {0x0870, 0x0887}, {0x0889, 0x088E}, {0x0898, 0x08E1},
+    {0x08E3, 0x0963}, {0x0971, 0x0983}, {0x0985, 0x098C}, {0x098F, 0x0990}, {0x0993, 0x09A8},
+    {0x09AA, 0x09B0}, {0x09B2, 0x09B2}, {0x09B6, 0x09B9}, {0x09BC, 0x09C4}, {0x09C7, 0x09C8},
+    {0x09CB, 0x09CE}, {0x09D7, 0x09D7}, {0x09DC, 0x09DD}, {0x09DF, 0x09E3}, {0x09F0, 0x09F1},
+    {0x09FC, 0x09FC}, {0x09FE, 0x09FE}, {0x0A01, 0x0A03}, {0x0A05, 0x0A0A}, {0x0A0F, 0x0A10},
+    {0x0A13, 0x0A28}, {0x0A2A, 0x0A30}, {0x0A32, 0x0A33}, {0x0A35, 0x0A36}, {0x0A38, 0x0A39},
+    {0x0A3C, 0x0A3C}, {0x0A3E, 0x0A42}, {0x0A47, 0x0A48}, {0x0A4B, 0x0A4D}, {0x0A51, 0x0A51},
+    {0x0A59, 0x0A5C}, {0x0A5E, 0x0A5E}, {0x0A70, 0x0A75}, {0x0A81, 0x0A83}, {0x0A85, 0x0A8D},
+    {0x0A8F, 0x0A91}, {0x0A93, 0x0AA8}, {0x0AAA, 0x0AB0}, {0x0AB2, 0x0AB3}, {0x0AB5, 0x0AB9},
+    {0x0ABC, 0x0AC5}, {0x0AC7, 0x0AC9}, {0x0ACB, 0x0ACD}, {0x0AD0, 0x0AD0}, {0x0AE0, 0x0AE3},
+    {0x0AF9, 0x0AFF}, {0x0B01, 0x0B03}, {0x0B05, 0x0B0C}, {0x0B0F, 0x0B10}, {0x0B13, 0x0B28},
+    {0x0B2A, 0x0B30}, {0x0B32, 0x0B33}, {0x0B35, 0x0B39}, {0x0B3C, 0x0B44}, {0x0B47, 0x0B48},
+    {0x0B4B, 0x0B4D}, {0x0B55, 0x0B57}, {0x0B5C, 0x0B5D}, {0x0B5F, 0x0B63}, {0x0B71, 0x0B71},
+    {0x0B82, 0x0B83}, {0x0B85, 0x0B8A}, {0x0B8E, 0x0B90}, {0x0B92, 0x0B95}, {0x0B99, 0x0B9A},
+    {0x0B9C, 0x0B9C}, {0x0B9E, 0x0B9F}, {0x0BA3, 0x0BA4}, {0x0BA8, 0x0BAA}, {0x0BAE, 0x0BB9},
+    {0x0BBE, 0x0BC2}, {0x0BC6, 0x0BC8}, {0x0BCA, 0x0BCD}, {0x0BD0, 0x0BD0}, {0x0BD7, 0x0BD7},
+    {0x0C00, 0x0C0C}, {0x0C0E, 0x0C10}, {0x0C12, 0x0C28}, {0x0C2A, 0x0C39}, {0x0C3C, 0x0C44},
+    {0x0C46, 0x0C48}, {0x0C4A, 0x0C4D}, {0x0C55, 0x0C56}, {0x0C58, 0x0C5A}, {0x0C5D, 0x0C5D},
+    {0x0C60, 0x0C63}, {0x0C80, 0x0C83}, {0x0C85, 0x0C8C}, {0x0C8E, 0x0C90}, {0x0C92, 0x0CA8},
+    {0x0CAA, 0x0CB3}, {0x0CB5, 0x0CB9}, {0x0CBC, 0x0CC4}, {0x0CC6, 0x0CC8}, {0x0CCA, 0x0CCD},
+    {0x0CD5, 0x0CD6}, {0x0CDD, 0x0CDE}, {0x0CE0, 0x0CE3}, {0x0CF1, 0x0CF2}, {0x0D00, 0x0D0C},
+    {0x0D0E, 0x0D10}, {0x0D12, 0x0D44}, {0x0D46, 0x0D48}, {0x0D4A, 0x0D4E}, {0x0D54, 0x0D57},
+    {0x0D5F, 0x0D63}, {0x0D7A, 0x0D7F}, {0x0D81, 0x0D83}, {0x0D85, 0x0D96}, {0x0D9A, 0x0DB1},
+    {0x0DB3, 0x0DBB}, {0x0DBD, 0x0DBD}, {0x0DC0, 0x0DC6}, {0x0DCA, 0x0DCA}, {0x0DCF, 0x0DD4},
+    {0x0DD6, 0x0DD6}, {0x0DD8, 0x0DDF}, {0x0DF2, 0x0DF3}, {0x0E01, 0x0E3A}, {0x0E40, 0x0E4E},
+    {0x0E81, 0x0E82}, {0x0E84, 0x0E84}, {0x0E86, 0x0E8A}, {0x0E8C, 0x0EA3}, {0x0EA5, 0x0EA5},
+    {0x0EA7, 0x0EBD}, {0x0EC0, 0x0EC4}, {0x0EC6, 0x0EC6}, {0x0EC8, 0x0ECD}, {0x0EDC, 0x0EDF},
+    {0x0F00, 0x0F00}, {0x0F18, 0x0F19}, {0x0F35, 0x0F35}, {0x0F37, 0x0F37}, {0x0F39, 0x0F39},
+    {0x0F3E, 0x0F47}, {0x0F49, 0x0F6C}, {0x0F71, 0x0F84}, {0x0F86, 0x0F97}, {0x0F99, 0x0FBC},
+    {0x0FC6, 0x0FC6}, {0x1000, 0x103F}, {0x1050, 0x108F}, {0x109A, 0x109D}, {0x10A0, 0x10C5},
+    {0x10C7, 0x10C7}, {0x10CD, 0x10CD}, {0x10D0, 0x10FA}, {0x10FC, 0x1248}, {0x124A, 0x124D},
+    {0x1250, 0x1256}, {0x1258, 0x1258}, {0x125A, 0x125D}, {0x1260, 0x1288}, {0x128A, 0x128D},
+    {0x1290, 0x12B0}, {0x12B2, 0x12B5}, {0x12B8, 0x12BE}, {0x12C0, 0x12C0}, {0x12C2, 0x12C5},
+    {0x12C8, 0x12D6}, {0x12D8, 0x1310}, {0x1312, 0x1315}, {0x1318, 0x135A}, {0x135D, 0x135F},
+    {0x1380, 0x138F}, {0x13A0, 0x13F5}, {0x13F8, 0x13FD}, {0x1401, 0x166C}, {0x166F, 0x167F},
+    {0x1681, 0x169A}, {0x16A0, 0x16EA}, {0x16F1, 0x16F8}, {0x1700, 0x1715}, {0x171F, 0x1734},
+    {0x1740, 0x1753}, {0x1760, 0x176C}, {0x176E, 0x1770}, {0x1772, 0x1773}, {0x1780, 0x17D3},
+    {0x17D7, 0x17D7}, {0x17DC, 0x17DD}, {0x180B, 0x180D}, {0x180F, 0x180F}, {0x1820, 0x1878},
+    {0x1880, 0x18AA}, {0x18B0, 0x18F5}, {0x1900, 0x191E}, {0x1920, 0x192B}, {0x1930, 0x193B},
+    {0x1950, 0x196D}, {0x1970, 0x1974}, {0x1980, 0x19AB}, {0x19B0, 0x19C9}, {0x1A00, 0x1A1B},
+    {0x1A20, 0x1A5E}, {0x1A60, 0x1A7C}, {0x1A7F, 0x1A7F}, {0x1AA7, 0x1AA7}, {0x1AB0, 0x1ACE},
+    {0x1B00, 0x1B4C}, {0x1B6B, 0x1B73}, {0x1B80, 0x1BAF}, {0x1BBA, 0x1BF3}, {0x1C00, 0x1C37},
+    {0x1C4D, 0x1C4F}, {0x1C5A, 0x1C7D}, {0x1C80, 0x1C88}, {0x1C90, 0x1CBA}, {0x1CBD, 0x1CBF},
+    {0x1CD0, 0x1CD2}, {0x1CD4, 0x1CFA}, {0x1D00, 0x1F15}, {0x1F18, 0x1F1D}, {0x1F20, 0x1F45},
+    {0x1F48, 0x1F4D}, {0x1F50, 0x1F57}, {0x1F59, 0x1F59}, {0x1F5B, 0x1F5B}, {0x1F5D, 0x1F5D},
+    {0x1F5F, 0x1F7D}, {0x1F80, 0x1FB4}, {0x1FB6, 0x1FBC}, {0x1FBE, 0x1FBE}, {0x1FC2, 0x1FC4},
+    {0x1FC6, 0x1FCC}, {0x1FD0, 0x1FD3}, {0x1FD6, 0x1FDB}, {0x1FE0, 0x1FEC}, {0x1FF2, 0x1FF4},
+    {0x1FF6, 0x1FFC}, {0x2071, 0x2071}, {0x207F, 0x207F}, {0x2090, 0x209C}, {0x20D0, 0x20F0},
+    {0x2102, 0x2102}, {0x2107, 0x2107}, {0x210A, 0x2113}, {0x2115, 0x2115}, {0x2119, 0x211D},
+    {0x2124, 0x2124}, {0x2126, 0x2126}, {0x2128, 0x2128}, {0x212A, 0x212D}, {0x212F, 0x2139},
+    {0x213C, 0x213F}, {0x2145, 0x2149}, {0x214E, 0x214E}, {0x2183, 0x2184}, {0x2C00, 0x2CE4},
+    {0x2CEB, 0x2CF3}, {0x2D00, 0x2D25}, {0x2D27, 0x2D27}, {0x2D2D, 0x2D2D}, {0x2D30, 0x2D67},
+    {0x2D6F, 0x2D6F}, {0x2D7F, 0x2D96}, {0x2DA0, 0x2DA6}, {0x2DA8, 0x2DAE}, {0x2DB0, 0x2DB6},
+    {0x2DB8, 0x2DBE}, {0x2DC0, 0x2DC6}, {0x2DC8, 0x2DCE}, {0x2DD0, 0x2DD6}, {0x2DD8, 0x2DDE},
+    {0x2DE0, 0x2DFF}, {0x2E2F, 0x2E2F}, {0x3005, 0x3006}, {0x302A, 0x302F}, {0x3031, 0x3035},
+    {0x303B, 0x303C}, {0x3041, 0x3096}, {0x3099, 0x309A}, {0x309D, 0x309F}, {0x30A1, 0x30FA},
+    {0x30FC, 0x30FF}, {0x3105, 0x312F}, {0x3131, 0x318E}, {0x31A0, 0x31BF}, {0x31F0, 0x31FF},
+    {0x3400, 0x4DBF}, {0x4E00, 0xA48C}, {0xA4D0, 0xA4FD}, {0xA500, 0xA60C}, {0xA610, 0xA61F},
+    {0xA62A, 0xA62B}, {0xA640, 0xA672}, {0xA674, 0xA67D}, {0xA67F, 0xA6E5}, {0xA6F0, 0xA6F1},
+    {0xA717, 0xA71F}, {0xA722, 0xA788}, {0xA78B, 0xA7CA}, {0xA7D0, 0xA7D1}, {0xA7D3, 0xA7D3},
+    {0xA7D5, 0xA7D9}, {0xA7F2, 0xA827}, {0xA82C, 0xA82C}, {0xA840, 0xA873}, {0xA880, 0xA8C5},
+    {0xA8E0, 0xA8F7}, {0xA8FB, 0xA8FB}, {0xA8FD, 0xA8FF}, {0xA90A, 0xA92D}, {0xA930, 0xA953},
+    {0xA960, 0xA97C}, {0xA980, 0xA9C0}, {0xA9CF, 0xA9CF}, {0xA9E0, 0xA9EF}, {0xA9FA, 0xA9FE},
+    {0xAA00, 0xAA36}, {0xAA40, 0xAA4D}, {0xAA60, 0xAA76}, {0xAA7A, 0xAAC2}, {0xAADB, 0xAADD},
+    {0xAAE0, 0xAAEF}, {0xAAF2, 0xAAF6}, {0xAB01, 0xAB06}, {0xAB09, 0xAB0E}, {0xAB11, 0xAB16},
+    {0xAB20, 0xAB26}, {0xAB28, 0xAB2E}, {0xAB30, 0xAB5A}, {0xAB5C, 0xAB69}, {0xAB70, 0xABEA},
+    {0xABEC, 0xABED}, {0xAC00, 0xD7A3}, {0xD7B0, 0xD7C6}, {0xD7CB, 0xD7FB}, {0xF900, 0xFA6D},
+    {0xFA70, 0xFAD9}, {0xFB00, 0xFB06}, {0xFB13, 0xFB17}, {0xFB1D, 0xFB28}, {0xFB2A, 0xFB36},
+    {0xFB38, 0xFB3C}, {0xFB3E, 0xFB3E}, {0xFB40, 0xFB41}, {0xFB43, 0xFB44}, {0xFB46, 0xFBB1},
+    {0xFBD3, 0xFD3D}, {0xFD50, 0xFD8F}, {0xFD92, 0xFDC7}, {0xFDF0, 0xFDFB}, {0xFE00, 0xFE0F},
+    {0xFE20, 0xFE2F}, {0xFE70, 0xFE74}, {0xFE76, 0xFEFC}, {0xFF21, 0xFF3A}, {0xFF41, 0xFF5A},
+    {0xFF66, 0xFFBE}, {0xFFC2, 0xFFC7}, {0xFFCA, 0xFFCF}, {0xFFD2, 0xFFD7}, {0xFFDA, 0xFFDC},
+    {0x10000, 0x1000B}, {0x1000D, 0x10026}, {0x10028, 0x1003A}, {0x1003C, 0x1003D}, {0x1003F, 0x1004D},
+    {0x10050, 0x1005D}, {0x10080, 0x100FA}, {0x101FD, 0x101FD}, {0x10280, 0x1029C}, {0x102A0, 0x102D0},
+    {0x102E0, 0x102E0}, {0x10300, 0x1031F}, {0x1032D, 0x10340}, {0x10342, 0x10349}, {0x10350, 0x1037A},
+    {0x10380, 0x1039D}, {0x103A0, 0x103C3}, {0x103C8, 0x103CF}, {0x10400, 0x1049D}, {0x104B0, 0x104D3},
+    {0x104D8, 0x104FB}, {0x10500, 0x10527}, {0x10530, 0x10563}, {0x10570, 0x1057A}, {0x1057C, 0x1058A},
+    {0x1058C, 0x10592}, {0x10594, 0x10595}, {0x10597, 0x105A1}, {0x105A3, 0x105B1}, {0x105B3, 0x105B9},
+    {0x105BB, 0x105BC}, {0x10600, 0x10736}, {0x10740, 0x10755}, {0x10760, 0x10767}, {0x10780, 0x10785},
+    {0x10787, 0x107B0}, {0x107B2, 0x107BA}, {0x10800, 0x10805}, {0x10808, 0x10808}, {0x1080A, 0x10835},
+    {0x10837, 0x10838}, {0x1083C, 0x1083C}, {0x1083F, 0x10855}, {0x10860, 0x10876}, {0x10880, 0x1089E},
+    {0x108E0, 0x108F2}, {0x108F4, 0x108F5}, {0x10900, 0x10915}, {0x10920, 0x10939}, {0x10980, 0x109B7},
+    {0x109BE, 0x109BF}, {0x10A00, 0x10A03}, {0x10A05, 0x10A06}, {0x10A0C, 0x10A13}, {0x10A15, 0x10A17},
+    {0x10A19, 0x10A35}, {0x10A38, 0x10A3A}, {0x10A3F, 0x10A3F}, {0x10A60, 0x10A7C}, {0x10A80, 0x10A9C},
+    {0x10AC0, 0x10AC7}, {0x10AC9, 0x10AE6}, {0x10B00, 0x10B35}, {0x10B40, 0x10B55}, {0x10B60, 0x10B72},
+    {0x10B80, 0x10B91}, {0x10C00, 0x10C48}, {0x10C80, 0x10CB2}, {0x10CC0, 0x10CF2}, {0x10D00, 0x10D27},
+    {0x10E80, 0x10EA9}, {0x10EAB, 0x10EAC}, {0x10EB0, 0x10EB1}, {0x10F00, 0x10F1C}, {0x10F27, 0x10F27},
+    {0x10F30, 0x10F50}, {0x10F70, 0x10F85}, {0x10FB0, 0x10FC4}, {0x10FE0, 0x10FF6}, {0x11000, 0x11046},
+    {0x11070, 0x11075}, {0x1107F, 0x110BA}, {0x110C2, 0x110C2}, {0x110D0, 0x110E8}, {0x11100, 0x11134},
+    {0x11144, 0x11147}, {0x11150, 0x11173}, {0x11176, 0x11176}, {0x11180, 0x111C4}, {0x111C9, 0x111CC},
+    {0x111CE, 0x111CF}, {0x111DA, 0x111DA}, {0x111DC, 0x111DC}, {0x11200, 0x11211}, {0x11213, 0x11237},
+    {0x1123E, 0x1123E}, {0x11280, 0x11286}, {0x11288, 0x11288}, {0x1128A, 0x1128D}, {0x1128F, 0x1129D},
+    {0x1129F, 0x112A8}, {0x112B0, 0x112EA}, {0x11300, 0x11303}, {0x11305, 0x1130C}, {0x1130F, 0x11310},
+    {0x11313, 0x11328}, {0x1132A, 0x11330}, {0x11332, 0x11333}, {0x11335, 0x11339}, {0x1133B, 0x11344},
+    {0x11347, 0x11348}, {0x1134B, 0x1134D}, {0x11350, 0x11350}, {0x11357, 0x11357}, {0x1135D, 0x11363},
+    {0x11366, 0x1136C}, {0x11370, 0x11374}, {0x11400, 0x1144A}, {0x1145E, 0x11461}, {0x11480, 0x114C5},
+    {0x114C7, 0x114C7}, {0x11580, 0x115B5}, {0x115B8, 0x115C0}, {0x115D8, 0x115DD}, {0x11600, 0x11640},
+    {0x11644, 0x11644}, {0x11680, 0x116B8}, {0x11700, 0x1171A}, {0x1171D, 0x1172B}, {0x11740, 0x11746},
+    {0x11800, 0x1183A}, {0x118A0, 0x118DF}, {0x118FF, 0x11906}, {0x11909, 0x11909}, {0x1190C, 0x11913},
+    {0x11915, 0x11916}, {0x11918, 0x11935}, {0x11937, 0x11938}, {0x1193B, 0x11943}, {0x119A0, 0x119A7},
+    {0x119AA, 0x119D7}, {0x119DA, 0x119E1}, {0x119E3, 0x119E4}, {0x11A00, 0x11A3E}, {0x11A47, 0x11A47},
+    {0x11A50, 0x11A99}, {0x11A9D, 0x11A9D}, {0x11AB0, 0x11AF8}, {0x11C00, 0x11C08}, {0x11C0A, 0x11C36},
+    {0x11C38, 0x11C40}, {0x11C72, 0x11C8F}, {0x11C92, 0x11CA7}, {0x11CA9, 0x11CB6}, {0x11D00, 0x11D06},
+    {0x11D08, 0x11D09}, {0x11D0B, 0x11D36}, {0x11D3A, 0x11D3A}, {0x11D3C, 0x11D3D}, {0x11D3F, 0x11D47},
+    {0x11D60, 0x11D65}, {0x11D67, 0x11D68}, {0x11D6A, 0x11D8E}, {0x11D90, 0x11D91}, {0x11D93, 0x11D98},
+    {0x11EE0, 0x11EF6}, {0x11FB0, 0x11FB0}, {0x12000, 0x12399}, {0x12480, 0x12543}, {0x12F90, 0x12FF0},
+    {0x13000, 0x1342E}, {0x14400, 0x14646}, {0x16800, 0x16A38}, {0x16A40, 0x16A5E}, {0x16A70, 0x16ABE},
+    {0x16AD0, 0x16AED}, {0x16AF0, 0x16AF4}, {0x16B00, 0x16B36}, {0x16B40, 0x16B43}, {0x16B63, 0x16B77},
+    {0x16B7D, 0x16B8F}, {0x16E40, 0x16E7F}, {0x16F00, 0x16F4A}, {0x16F4F, 0x16F87}, {0x16F8F, 0x16F9F},
+    {0x16FE0, 0x16FE1}, {0x16FE3, 0x16FE4}, {0x16FF0, 0x16FF1}, {0x17000, 0x187F7}, {0x18800, 0x18CD5},
+    {0x18D00, 0x18D08}, {0x1AFF0, 0x1AFF3}, {0x1AFF5, 0x1AFFB}, {0x1AFFD, 0x1AFFE}, {0x1B000, 0x1B122},
+    {0x1B150, 0x1B152}, {0x1B164, 0x1B167}, {0x1B170, 0x1B2FB}, {0x1BC00, 0x1BC6A}, {0x1BC70, 0x1BC7C},
+    {0x1BC80, 0x1BC88}, {0x1BC90, 0x1BC99}, {0x1BC9D, 0x1BC9E}, {0x1CF00, 0x1CF2D}, {0x1CF30, 0x1CF46},
+    {0x1D165, 0x1D169}, {0x1D16D, 0x1D172}, {0x1D17B, 0x1D182}, {0x1D185, 0x1D18B}, {0x1D1AA, 0x1D1AD},
+    {0x1D242, 0x1D244}, {0x1D400, 0x1D454}, {0x1D456, 0x1D49C}, {0x1D49E, 0x1D49F}, {0x1D4A2, 0x1D4A2},
+    {0x1D4A5, 0x1D4A6}, {0x1D4A9, 0x1D4AC}, {0x1D4AE, 0x1D4B9}, {0x1D4BB, 0x1D4BB}, {0x1D4BD, 0x1D4C3},
+    {0x1D4C5, 0x1D505}, {0x1D507, 0x1D50A}, {0x1D50D, 0x1D514}, {0x1D516, 0x1D51C}, {0x1D51E, 0x1D539},
+    {0x1D53B, 0x1D53E}, {0x1D540, 0x1D544}, {0x1D546, 0x1D546}, {0x1D54A, 0x1D550}, {0x1D552, 0x1D6A5},
+    {0x1D6A8, 0x1D6C0}, {0x1D6C2, 0x1D6DA}, {0x1D6DC, 0x1D6FA}, {0x1D6FC, 0x1D714}, {0x1D716, 0x1D734},
+    {0x1D736, 0x1D74E}, {0x1D750, 0x1D76E}, {0x1D770, 0x1D788}, {0x1D78A, 0x1D7A8}, {0x1D7AA, 0x1D7C2},
+    {0x1D7C4, 0x1D7CB}, {0x1DA00, 0x1DA36}, {0x1DA3B, 0x1DA6C}, {0x1DA75, 0x1DA75}, {0x1DA84, 0x1DA84},
+    {0x1DA9B, 0x1DA9F}, {0x1DAA1, 0x1DAAF}, {0x1DF00, 0x1DF1E}, {0x1E000, 0x1E006}, {0x1E008, 0x1E018},
+    {0x1E01B, 0x1E021}, {0x1E023, 0x1E024}, {0x1E026, 0x1E02A}, {0x1E100, 0x1E12C}, {0x1E130, 0x1E13D},
+    {0x1E14E, 0x1E14E}, {0x1E290, 0x1E2AE}, {0x1E2C0, 0x1E2EF}, {0x1E7E0, 0x1E7E6}, {0x1E7E8, 0x1E7EB},
+    {0x1E7ED, 0x1E7EE}, {0x1E7F0, 0x1E7FE}, {0x1E800, 0x1E8C4}, {0x1E8D0, 0x1E8D6}, {0x1E900, 0x1E94B},
+    {0x1EE00, 0x1EE03}, {0x1EE05, 0x1EE1F}, {0x1EE21, 0x1EE22}, {0x1EE24, 0x1EE24}, {0x1EE27, 0x1EE27},
+    {0x1EE29, 0x1EE32}, {0x1EE34, 0x1EE37}, {0x1EE39, 0x1EE39}, {0x1EE3B, 0x1EE3B}, {0x1EE42, 0x1EE42},
+    {0x1EE47, 0x1EE47}, {0x1EE49, 0x1EE49}, {0x1EE4B, 0x1EE4B}, {0x1EE4D, 0x1EE4F}, {0x1EE51, 0x1EE52},
+    {0x1EE54, 0x1EE54}, {0x1EE57, 0x1EE57}, {0x1EE59, 0x1EE59}, {0x1EE5B, 0x1EE5B}, {0x1EE5D, 0x1EE5D},
+    {0x1EE5F, 0x1EE5F}, {0x1EE61, 0x1EE62}, {0x1EE64, 0x1EE64}, {0x1EE67, 0x1EE6A}, {0x1EE6C, 0x1EE72},
+    {0x1EE74, 0x1EE77}, {0x1EE79, 0x1EE7C}, {0x1EE7E, 0x1EE7E}, {0x1EE80, 0x1EE89}, {0x1EE8B, 0x1EE9B},
+    {0x1EEA1, 0x1EEA3}, {0x1EEA5, 0x1EEA9}, {0x1EEAB, 0x1EEBB}, {0x20000, 0x2A6DF}, {0x2A700, 0x2B738},
+    {0x2B740, 0x2B81D}, {0x2B820, 0x2CEA1}, {0x2CEB0, 0x2EBE0}, {0x2F800, 0x2FA1D}, {0x30000, 0x3134A},
+    {0xE0100, 0xE01EF}
+};
+
+// Code points from U+0080 up that are whitespace, sorted
+
+static const uint32_t unicodeSpaces[] = {
+    0x0085, 0x00A0, 0x1680, 0x2000, 0x2001, 0x2002, 0x2003, 0x2004,
+    0x2005, 0x2006, 0x2007, 0x2008, 0x2009, 0x200A, 0x2028, 0x2029,
+    0x202F, 0x205F, 0x3000
+};
+
+// Simple lowercase mappings from U+0080 up, as runs of {first, last, delta, stride}: every
+// stride-th code point from first to last maps to itself plus delta. Sorted by first code point.
+
+static const int32_t caseRuns[][4] = {
+    {0x00C0, 0x00D6, 32, 1}, {0x00D8, 0x00DE, 32, 1}, {0x0100, 0x012E, 1, 2},
+    {0x0132, 0x0136, 1, 2}, {0x0139, 0x0147, 1, 2}, {0x014A, 0x0176, 1, 2},
+    {0x0178, 0x0178, -121, 1}, {0x0179, 0x017D, 1, 2}, {0x0181, 0x0181, 210, 1},
+    {0x0182, 0x0184, 1, 2}, {0x0186, 0x0186, 206, 1}, {0x0187, 0x0187, 1, 1},
+    {0x0189, 0x018A, 205, 1}, {0x018B, 0x018B, 1, 1}, {0x018E, 0x018E, 79, 1},
+    {0x018F, 0x018F, 202, 1}, {0x0190, 0x0190, 203, 1}, {0x0191, 0x0191, 1, 1},
+    {0x0193, 0x0193, 205, 1}, {0x0194, 0x0194, 207, 1}, {0x0196, 0x0196, 211, 1},
+    {0x0197, 0x0197, 209, 1}, {0x0198, 0x0198, 1, 1}, {0x019C, 0x019C, 211, 1},
+    {0x019D, 0x019D, 213, 1}, {0x019F, 0x019F, 214, 1}, {0x01A0, 0x01A4, 1, 2},
+    {0x01A6, 0x01A6, 218, 1}, {0x01A7, 0x01A7, 1, 1}, {0x01A9, 0x01A9, 218, 1},
+    {0x01AC, 0x01AC, 1, 1}, {0x01AE, 0x01AE, 218, 1}, {0x01AF, 0x01AF, 1, 1},
+    {0x01B1, 0x01B2, 217, 1}, {0x01B3, 0x01B5, 1, 2}, {0x01B7, 0x01B7, 219, 1},
+    {0x01B8, 0x01B8, 1, 1}, {0x01BC, 0x01BC, 1, 1}, {0x01C4, 0x01C4, 2, 1},
+    {0x01C5, 0x01C5, 1, 1}, {0x01C7, 0x01C7, 2, 1}, {0x01C8, 0x01C8, 1, 1},
+    {0x01CA, 0x01CA, 2, 1}, {0x01CB, 0x01DB, 1, 2}, {0x01DE, 0x01EE, 1, 2},
+    {0x01F1, 0x01F1, 2, 1}, {0x01F2, 0x01F4, 1, 2}, {0x01F6, 0x01F6, -97, 1},
+    {0x01F7, 0x01F7, -56, 1}, {0x01F8, 0x021E, 1, 2}, {0x0220, 0x0220, -130, 1},
+    {0x0222, 0x0232, 1, 2}, {0x023A, 0x023A, 10795, 1}, {0x023B, 0x023B, 1, 1},
+    {0x023D, 0x023D, -163, 1}, {0x023E, 0x023E, 10792, 1}, {0x0241, 0x0241, 1, 1},
+    {0x0243, 0x0243, -195, 1}, {0x0244, 0x0244, 69, 1}, {0x0245, 0x0245, 71, 1},
+    {0x0246, 0x024E, 1, 2}, {0x0370, 0x0372, 1, 2}, {0x0376, 0x0376, 1, 1},
+    {0x037F, 0x037F, 116, 1}, {0x0386, 0x0386, 38, 1}, {0x0388, 0x038A, 37, 1},
+    {0x038C, 0x038C, 64, 1}, {0x038E, 0x038F, 63, 1}, {0x0391, 0x03A1, 32, 1},
+    {0x03A3, 0x03AB, 32, 1}, {0x03CF, 0x03CF, 8, 1}, {0x03D8, 0x03EE, 1, 2},
+    {0x03F4, 0x03F4, -60, 1}, {0x03F7, 0x03F7, 1, 1}, {0x03F9, 0x03F9, -7, 1},
+    {0x03FA, 0x03FA, 1, 1}, {0x03FD, 0x03FF, -130, 1}, {0x0400, 0x040F, 80, 1},
+    {0x0410, 0x042F, 32, 1}, {0x0460, 0x0480, 1, 2}, {0x048A, 0x04BE, 1, 2},
+    {0x04C0, 0x04C0, 15, 1}, {0x04C1, 0x04CD, 1, 2}, {0x04D0, 0x052E, 1, 2},
+    {0x0531, 0x0556, 48, 1}, {0x10A0, 0x10C5, 7264, 1}, {0x10C7, 0x10C7, 7264, 1},
+    {0x10CD, 0x10CD, 7264, 1}, {0x13A0, 0x13EF, 38864, 1}, {0x13F0, 0x13F5, 8, 1},
+    {0x1C90, 0x1CBA, -3008, 1}, {0x1CBD, 0x1CBF, -3008, 1}, {0x1E00, 0x1E94, 1, 2},
+    {0x1E9E, 0x1E9E, -7615, 1}, {0x1EA0, 0x1EFE, 1, 2}, {0x1F08, 0x1F0F, -8, 1},
+    {0x1F18, 0x1F1D, -8, 1}, {0x1F28, 0x1F2F, -8, 1}, {0x1F38, 0x1F3F, -8, 1},
+    {0x1F48, 0x1F4D, -8, 1}, {0x1F59, 0x1F5F, -8, 2}, {0x1F68, 0x1F6F, -8, 1},
+    {0x1F88, 0x1F8F, -8, 1}, {0x1F98, 0x1F9F, -8, 1}, {0x1FA8, 0x1FAF, -8, 1},
+    {0x1FB8, 0x1FB9, -8, 1}, {0x1FBA, 0x1FBB, -74, 1}, {0x1FBC, 0x1FBC, -9, 1},
+    {0x1FC8, 0x1FCB, -86, 1}, {0x1FCC, 0x1FCC, -9, 1}, {0x1FD8, 0x1FD9, -8, 1},
+    {0x1FDA, 0x1FDB, -100, 1}, {0x1FE8, 0x1FE9, -8, 1}, {0x1FEA, 0x1FEB, -112, 1},
+    {0x1FEC, 0x1FEC, -7, 1}, {0x1FF8, 0x1FF9, -128, 1}, {0x1FFA, 0x1FFB, -126, 1},
+    {0x1FFC, 0x1FFC, -9, 1}, {0x2126, 0x2126, -7517, 1}, {0x212A, 0x212A, -8383, 1},
+    {0x212B, 0x212B, -8262, 1}, {0x2132, 0x2132, 28, 1}, {0x2160, 0x216F, 16, 1},
+    {0x2183, 0x2183, 1, 1}, {0x24B6, 0x24CF, 26, 1}, {0x2C00, 0x2C2F, 48, 1},
+    {0x2C60, 0x2C60, 1, 1}, {0x2C62, 0x2C62, -10743, 1}, {0x2C63, 0x2C63, -3814, 1},
+    {0x2C64, 0x2C64, -10727, 1}, {0x2C67, 0x2C6B, 1, 2}, {0x2C6D, 0x2C6D, -10780, 1},
+    {0x2C6E, 0x2C6E, -10749, 1}, {0x2C6F, 0x2C6F, -10783, 1}, {0x2C70, 0x2C70, -10782, 1},
+    {0x2C72, 0x2C72, 1, 1}, {0x2C75, 0x2C75, 1, 1}, {0x2C7E, 0x2C7F, -10815, 1},
+    {0x2C80, 0x2CE2, 1, 2}, {0x2CEB, 0x2CED, 1, 2}, {0x2CF2, 0x2CF2, 1, 1},
+    {0xA640, 0xA66C, 1, 2}, {0xA680, 0xA69A, 1, 2}, {0xA722, 0xA72E, 1, 2},
+    {0xA732, 0xA76E, 1, 2}, {0xA779, 0xA77B, 1, 2}, {0xA77D, 0xA77D, -35332, 1},
+    {0xA77E, 0xA786, 1, 2}, {0xA78B, 0xA78B, 1, 1}, {0xA78D, 0xA78D, -42280, 1},
+    {0xA790, 0xA792, 1, 2}, {0xA796, 0xA7A8, 1, 2}, {0xA7AA, 0xA7AA, -42308, 1},
+    {0xA7AB, 0xA7AB, -42319, 1}, {0xA7AC, 0xA7AC, -42315, 1}, {0xA7AD, 0xA7AD, -42305, 1},
+    {0xA7AE, 0xA7AE, -42308, 1}, {0xA7B0, 0xA7B0, -42258, 1}, {0xA7B1, 0xA7B1, -42282, 1},
+    {0xA7B2, 0xA7B2, -42261, 1}, {0xA7B3, 0xA7B3, 928, 1}, {0xA7B4, 0xA7C2, 1, 2},
+    {0xA7C4, 0xA7C4, -48, 1}, {0xA7C5, 0xA7C5, -42307, 1}, {0xA7C6, 0xA7C6, -35384, 1},
+    {0xA7C7, 0xA7C9, 1, 2}, {0xA7D0, 0xA7D0, 1, 1}, {0xA7D6, 0xA7D8, 1, 2},
+    {0xA7F5, 0xA7F5, 1, 1}, {0xFF21, 0xFF3A, 32, 1}, {0x10400, 0x10427, 40, 1},
+    {0x104B0, 0x104D3, 40, 1}, {0x10570, 0x1057A, 39, 1}, {0x1057C, 0x1058A, 39, 1},
+    {0x1058C, 0x10592, 39, 1}, {0x10594, 0x10595, 39, 1}, {0x10C80, 0x10CB2, 64, 1},
+    {0x118A0, 0x118BF, 32, 1}, {0x16E40, 0x16E5F, 32, 1}, {0x1E900, 0x1E921, 34, 1}
+};
+
+/*
+ * skipSpace() skips the whitespace at pos, ASCII or Unicode.
+ * 
+ * @param const char *data as the contents of the file
+ * @param size_t pos as the first byte to look at
+ * @param size_t length as the number of bytes in the contents
+ * 
+ * @return position of the first byte that is not whitespace
+ * 
+ */
+
+size_t skipSpace(const char *data, size_t pos, size_t length)
+{
+    while (pos < length)
+    {
+        if ((unsigned char)data[pos] < 0x80)
+        {
+            if (!(charClass[(unsigned char)data[pos]] & CLASS_SPACE))
+            {
+                break;
+            }
+
+            pos++;
+            continue;
+        }
+
+        int bytes;
+
+        if (unicodeClass(decodeUTF8(data, pos, length, &bytes)) != CLASS_SPACE)
+        {
+            break;
+        }
+
+        pos += bytes;
+    }
+
+    return pos;
+}
+
+/*
+ * foldToken() goes through a token one code point at a time, up to the next whitespace,
+ * and writes its valid characters folded to lowercase as UTF-8. ASCII characters go
+ * through the class table, and every other code point through unicodeClass() and
+ * foldCase().
+ * 
+ * @param const char *data as the contents of the file
+ * @param size_t pos as the first byte of the token
+ * @param size_t length as the number of bytes in the contents
+ * @param char *out to write the folded token to, or NULL to only measure it
+ * @param size_t *outLength to store the number of bytes of the folded token in
+ * 
+ * @return position right after the last byte of the token
+ * 
+ */
+
+size_t foldToken(const char *data, size_t pos, size_t length, char *out, size_t *outLength)
+{
+    char encoded[4];
+    size_t used = 0;
+
+    while (pos < length)
+    {
+        unsigned char c = data[pos];
+
+        if (c < 0x80)
+        {
+            if (charClass[c] & CLASS_SPACE)
+            {
+                break;
+            }
+
+            if (charClass[c] & CLASS_WORD)
+            {
+                if (out != NULL)
+                {
+                    out[used] = c | 0x20;
+                }
+
+                used++;
+            }
+
+            pos++;
+            continue;
+        }
+
+        int bytes;
+        uint32_t code = decodeUTF8(data, pos, length, &bytes);
+        int class = unicodeClass(code);
+
+        if (class == CLASS_SPACE)
+        {
+            break;
+        }
+
+        if (class == CLASS_WORD)
+        {
+            int size = encodeUTF8(foldCase(code), encoded);
+
+            if (out != NULL)
+            {
+                memcpy(out + used, encoded, size);
+            }
+
+            used += size;
+        }
+
+        pos += bytes;
+    }
+
+    *outLength = used;
+
+    return pos;
+}
+
+/*
+ * decodeUTF8() decodes the code point of the UTF-8 sequence at pos. Overlong sequences,
+ * surrogates, code points over U+10FFFF and cut off sequences are not valid.
+ * 
+ * @param const char *data as the contents of the file
+ * @param size_t pos as the first byte of the sequence
+ * @param size_t length as the number of bytes in the contents
+ * @param int *bytes to store the length of the sequence in, 1 if it is not valid
+ * 
+ * @return code point, or UINT32_MAX if the sequence is not valid
+ * 
+ */
+
+uint32_t decodeUTF8(const char *data, size_t pos, size_t length, int *bytes)
+{
+    const unsigned char *seq = (const unsigned char *)data + pos;
+    uint32_t code;
+    uint32_t minimum;
+    int size;
+
+    *bytes = 1;
+
+    if (seq[0] < 0x80)
+    {
+        return seq[0];
+    }
+    else if ((seq[0] & 0xE0) == 0xC0)
+    {
+        code = seq[0] & 0x1F;
+        minimum = 0x80;
+        size = 2;
+    }
+    else if ((seq[0] & 0xF0) == 0xE0)
+    {
+        code = seq[0] & 0x0F;
+        minimum = 0x800;
+        size = 3;
+    }
+    else if ((seq[0] & 0xF8) == 0xF0)
+    {
+        code = seq[0] & 0x07;
+        minimum = 0x10000;
+        size = 4;
+    }
+    else
+    {
+        return UINT32_MAX;
+    }
+
+    if (length - pos < (size_t)size)
+    {
+        return UINT32_MAX;
+    }
+
+    for (int b = 1; b < size; b++)
+    {
+        if ((seq[b] & 0xC0) != 0x80)
+        {
+            return UINT32_MAX;
+        }
+
+        code = (code << 6) | (seq[b] & 0x3F);
+    }
+
+    if (code < minimum || code > 0x10FFFF || (code >= 0xD800 && code <= 0xDFFF))
+    {
+        return UINT32_MAX;
+    }
+
+    *bytes = size;
+
+    return code;
+}
+
+/*
+ * encodeUTF8() encodes a code point as UTF-8.
+ * 
+ * @param uint32_t code as the code point
+ * @param char *out to write the up to 4 bytes to
+ * 
+ * @return number of bytes written
+ * 
+ */
+
+int encodeUTF8(uint32_t code, char *out)
+{
+    if (code < 0x80)
+    {
+        out[0] = code;
+        return 1;
+    }
+
+    if (code < 0x800)
+    {
+        out[0] = 0xC0 | (code >> 6);
+        out[1] = 0x80 | (code & 0x3F);
+        return 2;
+    }
+
+    if (code < 0x10000)
+    {
+        out[0] = 0xE0 | (code >> 12);
+        out[1] = 0x80 | ((code >> 6) & 0x3F);
+        out[2] = 0x80 | (code & 0x3F);
+        return 3;
+    }
+
+    out[0] = 0xF0 | (code >> 18);
+    out[1] = 0x80 | ((code >> 12) & 0x3F);
+    out[2] = 0x80 | ((code >> 6) & 0x3F);
+    out[3] = 0x80 | (code & 0x3F);
+    return 4;
+}
+
+/*
+ * unicodeClass() classifies a code point from U+0080 up with binary searches of the
+ * whitespace and letter tables.
+ * 
+ * @param uint32_t code as the code point, or UINT32_MAX for a byte that is not valid UTF-8
+ * 
+ * @return CLASS_SPACE, CLASS_WORD, or 0 for any other character
+ * 
+ */
+
+int unicodeClass(uint32_t code)
+{
+    int lo = 0;
+    int hi = sizeof(unicodeSpaces) / sizeof(unicodeSpaces[0]);
+
+    while (lo < hi)
+    {
+        int mid = lo + (hi - lo) / 2;
+
+        if (unicodeSpaces[mid] < code)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+
+    if (lo < (int)(sizeof(unicodeSpaces) / sizeof(unicodeSpaces[0])) && unicodeSpaces[lo] == code)
+    {
+        return CLASS_SPACE;
+    }
+
+    // Finding the last letter range that starts at or before the code point
+
+    lo = 0;
+    hi = sizeof(letterRanges) / sizeof(letterRanges[0]);
+
+    while (lo < hi)
+    {
+        int mid = lo + (hi - lo) / 2;
+
+        if (letterRanges[mid][0] <= code)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+
+    return (lo > 0 && code <= letterRanges[lo - 1][1]) ? CLASS_WORD : 0;
+}
+
+/*
+ * foldCase() maps a code point from U+0080 up to its lowercase form, with a binary search
+ * of the case runs.
+ * 
+ * @param uint32_t code as the code point
+ * 
+ * @return lowercase code point, or the code point itself if it has none
+ * 
+ */
+
+uint32_t foldCase(uint32_t code)
+{
+    int lo = 0;
+    int hi = sizeof(caseRuns) / sizeof(caseRuns[0]);
+
+    while (lo < hi)
+    {
+        int mid = lo + (hi - lo) / 2;
+
+        if ((uint32_t)caseRuns[mid][0] <= code)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+
+    if (lo > 0)
+    {
+        const int32_t *run = caseRuns[lo - 1];
+
+        if (code <= (uint32_t)run[1] && (code - run[0]) % run[3] == 0)
+        {
+            return code + run[2];
+        }
+    }
+
+    return code;
+}
+
+/*
+ * vocabulary() gives every distinct word its final id and moves every file's words into
+ * the shared word arrays.
+ * 
+ * By now the merge thread has given every word a provisional id in the order it was first
+ * seen (see mergeFile()), so only the distinct words are left to sort here. Ids are then
+ * handed out in alphabetical order, which means that each file's ids (in the alphabetical
+ * order of its words, see finishWords()) turn into a run of ids sorted by id. The words of the
+ * vocabulary are copied into one block of text.
+ * 
+ * Every file's words then take up one run of the two shared arrays, its word ids and
+ * their occurrence counts, found through the file's ids and counts pointers, in the order
+ * of the file linked list. A duplicate of another file (see dedupFile()) shares the run of
+ * its original. Under --mem-limit, the arrays live in temporary files (see
+ * spillAlloc()). The probabilities are worked out from the counts where they
+ * are needed (see buildIndex()).
+ * 
+ * @param struct args with the file linked list
+ * 
+ */
+
+void vocabulary(struct args *argsParam)
+{
+    if (argsParam->vocabSize == 0)
+    {
+        return;
+    }
+
+    // Sorting the distinct words alphabetically, keeping track of their provisional ids
+
+    struct wordNode *words = (struct wordNode *)malloc(sizeof(struct wordNode) * argsParam->vocabSize);
+    struct wordNode **nodes = (struct wordNode **)malloc(sizeof(struct wordNode *) * argsParam->vocabSize);
+    size_t textLength = 0;
+
+    for (long v = 0; v < argsParam->vocabSize; v++)
+    {
+        words[v].word = argsParam->vocab[v];
+        words[v].id = v;
+        nodes[v] = &words[v];
+        textLength += strlen(argsParam->vocab[v]) + 1;
+    }
+
+    qsort(nodes, argsParam->vocabSize, sizeof(struct wordNode *), compareWords);
+
+    // Copying the words into the vocabulary text in alphabetical order and mapping each provisional id to its final id
+
+    int *finalIds = (int *)malloc(sizeof(int) * argsParam->vocabSize);
+    argsParam->vocabText = (char *)malloc(sizeof(char) * textLength);
+    char *text = argsParam->vocabText;
+
+    for (long v = 0; v < argsParam->vocabSize; v++)
+    {
+        finalIds[nodes[v]->id] = v;
+        argsParam->vocab[v] = text;
+        strcpy(text, nodes[v]->word);
+        text += strlen(text) + 1;
+        free(nodes[v]->word);
+    }
+
+    free(nodes);
+    free(words);
+
+    // Moving each file's ids into its run of the shared arrays under their final ids
+
+    long numNodes = 0;
+    struct fileNode *filePtr = argsParam->fileHead;
+
+    while (filePtr != NULL)
+    {
+        numNodes += filePtr->numWords;
+        filePtr = filePtr->next;
+    }
+
+    argsParam->numEntries = numNodes;
+    argsParam->wordIds = (int *)spillAlloc(argsParam, sizeof(int) * numNodes);
+    argsParam->wordCounts = (float *)spillAlloc(argsParam, sizeof(float) * numNodes);
+    long n = 0;
+    filePtr = argsParam->fileHead;
+
+    while (filePtr != NULL)
+    {
+        filePtr->wordStart = n;
+
+        for (int w = 0; w < filePtr->numWords; w++)
+        {
+            argsParam->wordIds[n] = finalIds[filePtr->ids[w]];
+            argsParam->wordCounts[n] = filePtr->counts[w];
+            n++;
+        }
+
+        if (filePtr->numWords > 0)
+        {
+            free(filePtr->ids);
+            free(filePtr->counts);
+        }
+
+        filePtr = filePtr->next;
+    }
+
+    free(finalIds);
+
+    // Duplicates have no words of their own and share the run of their original
+
+    filePtr = argsParam->fileHead;
+
+    while (filePtr != NULL)
+    {
+        if (filePtr->original != NULL)
+        {
+            filePtr->numWords = filePtr->original->numWords;
+            filePtr->wordStart = filePtr->original->wordStart;
+        }
+
+        filePtr = filePtr->next;
+    }
+
+    placeWords(argsParam);
+}
+
+/*
+ * placeWords() points every file's ids and counts at its run of the shared word arrays,
+ * once the arrays are complete and will no longer move.
+ * 
+ * @param struct args with the file linked list and the shared word arrays
+ * 
+ */
+
+void placeWords(struct args *argsParam)
+{
+    struct fileNode *filePtr = argsParam->fileHead;
+
+    while (filePtr != NULL)
+    {
+        if (filePtr->numWords > 0)
+        {
+            filePtr->ids = argsParam->wordIds + filePtr->wordStart;
+            filePtr->counts = argsParam->wordCounts + filePtr->wordStart;
+        }
+
+        filePtr = filePtr->next;
+    }
+}
+
+/*
+ * compareWords() is the qsort() comparator that orders word node pointers alphabetically.
+ * 
+ * @param pointers to two word node pointers
+ * 
+ * @return negative, zero or positive like strcmp()
+ * 
+ */
+
+int compareWords(const void *a, const void *b)
+{
+    const struct wordNode *word1 = *(struct wordNode *const *)a;
+    const struct wordNode *word2 = *(struct wordNode *const *)b;
+
+    return strcmp(word1->word, word2->word);
+}
+
+/*
+ * anal() analyzes all the file nodes, and calculates the Jensen-Shannon Distance
+ * for each file.
+ * 
+ * Every pair of files is compared exactly once. The pairs form the upper triangle of
+ * an N x N matrix, which is cut into square tiles of TILE_SIZE files on each side so
+ * that a worker keeps the same small group of posting lists hot in its cache. Instead of
+ * merging the word arrays of every pair, the workers use an inverted index from each word
+ * to the files that contain it (see buildIndex()), so only pairs that actually share a
+ * word cost any work and the rest are filled in directly. A pool of
+ * worker threads (one per online core) takes tiles from a shared counter until none
+ * are left, and each worker keeps the mean nodes it computes in its own buffer. Once
+ * every worker has been joined, the buffers are concatenated into one flat array and
+ * sorted once into report order with compareReport(), so the output does not depend on
+ * which worker computed which pair.
+ * 
+ * With --limit N, each worker's buffer is a bounded heap that only keeps the N results
+ * that come first in report order, and the heaps are merged into one bounded heap, so
+ * memory stays at N results per worker no matter how many pairs there are.
+ * 
+ * With --threshold T, the workers print the pairs at or under T themselves as they go,
+ * through a small buffer each (see flushStream()), and nothing is left to sort.
+ * 
+ * With --store, every file that is unchanged since the stored run gets its index in the
+ * store, and the pairs of two such files are copied from the store instead of computed.
+ * 
+ * Files with the same contents (see dedupFile()) form a group, and only one file of each
+ * group takes part in the tiles, so the matrix is over groups rather than files. Every
+ * mean node the workers compute is copied to each pair of files of the two groups by
+ * expandResult() before it is stored, and the files of a group are compared with each
+ * other once, so the report is the same as if every file had been compared.
+ * 
+ * With --mem-limit, each worker's buffer holds at most runLength mean nodes, and a full
+ * buffer is sorted and written out as a run (see spillRun()). Nothing is sorted here, and
+ * printing() merges the runs instead.
+ * 
+ * @param struct args with the file linked list
+ * 
+ */
+
+void anal(struct args *argsParam)
+{
+    struct pairTask task;
+    task.nextTile = 0;
+    task.limit = argsParam->limit;
+    task.threshold = argsParam->threshold;
+    task.runLength = 0;
+    task.runs = NULL;
+    task.allFiles = collectFiles(argsParam, &task.numAllFiles);
+
+    if (task.numAllFiles < 2)
+    {
+        free(task.allFiles);
+        return;
+    }
+
+    // Comparing one file for each distinct contents only
+
+    groupFiles(&task);
+    buildIndex(argsParam, &task);
+
+    // Matching the files with the stored ones, -1 meaning new or changed
+
+    task.storeIndex = (long *)malloc(sizeof(long) * (task.numFiles + 1));
+    task.stored = (argsParam->store == NULL) ? NULL : argsParam->store->files;
+
+    for (int i = 0; i < task.numFiles; i++)
+    {
+        task.storeIndex[i] = (argsParam->store == NULL) ? -1 : lookupStore(argsParam->store, task.files[i]);
+    }
+
+    long numBlocks = (task.numFiles + TILE_SIZE - 1) / TILE_SIZE;
+    task.numBlocks = numBlocks;
+    task.numTiles = numBlocks * (numBlocks + 1) / 2;
+
+    if (pthread_mutex_init(&task.lock, NULL) != 0 || pthread_mutex_init(&task.outputLock, NULL) != 0)
+    {
+        printf("Error: Mutex initialization failed, exiting\n");
+        exit(0);
+    }
+
+    // Creating one worker per online core, but never more workers than tiles
+
+    long numWorkers = numCores();
+
+    if (numWorkers > task.numTiles)
+    {
+        numWorkers = task.numTiles;
+    }
+
+    // Under --mem-limit, half of the limit goes to the workers' result buffers, and a full buffer is spilled as a sorted run
+
+    if (argsParam->memLimit > 0 && task.limit == 0 && task.threshold < 0)
+    {
+        task.runLength = argsParam->memLimit / 2 / numWorkers / sizeof(struct meanNode);
+        task.runLength = (task.runLength < STREAM_BUFFER) ? STREAM_BUFFER : task.runLength;
+
+        task.runs = (struct spillRuns *)malloc(sizeof(struct spillRuns));
+        task.runs->fd = -1;
+        task.runs->numRecords = 0;
+        task.runs->numRuns = 0;
+        task.runs->capacity = 16;
+        task.runs->runStart = (long *)malloc(sizeof(long) * (task.runs->capacity + 1));
+        task.runs->runStart[0] = 0;
+        task.runs->files = task.allFiles;
+        task.runs->fd = spillTemp();
+    }
+
+    struct pairWorker *workers = (struct pairWorker *)malloc(sizeof(struct pairWorker) * numWorkers);
+    double start = seconds(CLOCK_MONOTONIC);
+
+    for (long w = 0; w < numWorkers; w++)
+    {
+        workers[w].task = &task;
+        workers[w].results = NULL;
+        workers[w].numResults = 0;
+        workers[w].capacity = 0;
+        workers[w].numStream = 0;
+        workers[w].computed = 0;
+        workers[w].copied = 0;
+        workers[w].terms = 0;
+
+        if (pthread_create(&workers[w].id, NULL, analWorker, &workers[w]) != 0)
+        {
+            printf("Error: Creating thread unsuccessful, exiting\n");
+            exit(0);
+        }
+    }
+
+    // Joining the workers and merging their result buffers into one array
+
+    long numResults = 0;
+
+    for (long w = 0; w < numWorkers; w++)
+    {
+        pthread_join(workers[w].id, NULL);
+        numResults += workers[w].numResults;
+    }
+
+    // Adding up the counters of the workers for --stats
+
+    if (argsParam->stats != NULL)
+    {
+        argsParam->stats->pairTime = seconds(CLOCK_MONOTONIC) - start;
+        argsParam->stats->workers = numWorkers;
+
+        for (long w = 0; w < numWorkers; w++)
+        {
+            argsParam->stats->pairsComputed += workers[w].computed;
+            argsParam->stats->pairsStored += workers[w].copied;
+            argsParam->stats->sharedTerms += workers[w].terms;
+        }
+    }
+
+    // Spilling what is left in every buffer, so the results are all in sorted runs for mergeRuns()
+
+    if (task.runs != NULL)
+    {
+        for (long w = 0; w < numWorkers; w++)
+        {
+            spillRun(&workers[w]);
+            free(workers[w].results);
+        }
+
+        argsParam->runs = task.runs;
+        argsParam->numMeans = task.runs->numRecords;
+
+        pthread_mutex_destroy(&task.lock);
+        pthread_mutex_destroy(&task.outputLock);
+        free(workers);
+        free(task.index.start);
+        spillFree(argsParam, task.index.file, sizeof(int) * task.index.numPostings);
+        spillFree(argsParam, task.index.prob, sizeof(double) * task.index.numPostings);
+        spillFree(argsParam, task.index.weight, sizeof(double) * task.index.numPostings);
+        free(task.storeIndex);
+        free(task.files);
+        free(task.memberStart);
+        free(task.members);
+        return;
+    }
+
+    if (task.limit > 0 && numResults > task.limit)
+    {
+        numResults = task.limit;
+    }
+
+    struct meanNode *results = (struct meanNode *)malloc(sizeof(struct meanNode) * (numResults + 1));
+    long size = 0;
+
+    for (long w = 0; w < numWorkers; w++)
+    {
+        if (task.limit > 0)
+        {
+            for (long r = 0; r < workers[w].numResults; r++)
+            {
+                heapPush(results, &size, task.limit, workers[w].results[r]);
+            }
+        }
+        else
+        {
+            memcpy(results + size, workers[w].results, sizeof(struct meanNode) * workers[w].numResults);
+            size += workers[w].numResults;
+        }
+
+        free(workers[w].results);
+    }
+
+    // Sorting the results once into the order they are printed in
+
+    qsort(results, size, sizeof(struct meanNode), compareReport);
+
+    argsParam->means = results;
+    argsParam->numMeans = size;
+
+    pthread_mutex_destroy(&task.lock);
+    pthread_mutex_destroy(&task.outputLock);
+    free(workers);
+    free(task.index.start);
+    spillFree(argsParam, task.index.file, sizeof(int) * task.index.numPostings);
+    spillFree(argsParam, task.index.prob, sizeof(double) * task.index.numPostings);
+    spillFree(argsParam, task.index.weight, sizeof(double) * task.index.numPostings);
+    free(task.storeIndex);
+    free(task.files);
+    free(task.allFiles);
+    free(task.memberStart);
+    free(task.members);
+}
+
+/*
+ * analWorker() is the starting point of every analysis thread.
+ * 
+ * The function repeatedly takes the next tile index from the shared task and turns it
+ * into a pair of file blocks (row block <= column block). For every row file of the
+ * tile, it walks the posting list of each of its words, finding its own posting (and so
+ * its own probability) with a binary search and then skipping ahead with another to the
+ * columns of the tile, and queues every (row, column) pair that shares the word for
+ * the pair kernel of the --metric, which adds the term to that column's running sums.
+ * Jaccard has no kernel and only counts the shared words. Once the row is done, every
+ * pair of the row above the diagonal gets its mean node from finishMean(); pairs that
+ * share nothing simply have empty sums. The mean nodes are appended to the worker's own
+ * buffer, so no lock is held while computing.
+ * 
+ * Every mean node is between two groups of files, and goes through expandResult(). Files
+ * of the same group have identical contents, so their pairs are 0 without comparing
+ * anything.
+ * 
+ * When a --store was loaded, pairs of two stored files are copied with storedMean(). A
+ * row of a stored file in a tile without new columns is copied outright, and otherwise
+ * only the postings of pairs that involve a new file are queued for the kernel.
+ * 
+ * @param struct pairWorker with the shared task and the worker's result buffer
+ * 
+ */
+
+void *analWorker(void *param)
+{
+    struct pairWorker *worker = (struct pairWorker *)param;
+    struct pairTask *task = worker->task;
+
+    while (true)
+    {
+        // Taking the next tile off the shared counter
+
+        pthread_mutex_lock(&task->lock);
+        long tile = task->nextTile++;
+        pthread_mutex_unlock(&task->lock);
+
+        if (tile >= task->numTiles)
+        {
+            break;
+        }
+
+        // Finding the row block and column block of the tile in the upper triangle of blocks
+
+        long rowBlock = 0;
+        long rowLength = task->numBlocks;
+
+        while (tile >= rowLength)
+        {
+            tile -= rowLength;
+            rowBlock++;
+            rowLength--;
+        }
+
+        long colBlock = rowBlock + tile;
+
+        int rowEnd = (rowBlock + 1) * TILE_SIZE;
+        int colEnd = (colBlock + 1) * TILE_SIZE;
+
+        if (rowEnd > task->numFiles)
+        {
+            rowEnd = task->numFiles;
+        }
+
+        if (colEnd > task->numFiles)
+        {
+            colEnd = task->numFiles;
+        }
+
+        struct invertedIndex *index = &task->index;
+        struct kernelBlock block;
+
+        // Checking whether any column file of the tile has to be computed
+
+        bool freshColumns = false;
+
+        for (int j = colBlock * TILE_SIZE; j < colEnd; j++)
+        {
+            if (task->storeIndex[j] == -1)
+            {
+                freshColumns = true;
+            }
+        }
+
+        double sum1[TILE_SIZE];
+        double sum2[TILE_SIZE];
+        double shared1[TILE_SIZE];
+        double shared2[TILE_SIZE];
+        int common[TILE_SIZE];
+
+        for (int i = rowBlock * TILE_SIZE; i < rowEnd; i++)
+        {
+            // Reporting the files of the row's group with each other at 0, once, in the tile on the diagonal
+
+            if (rowBlock == colBlock && task->memberStart[i + 1] - task->memberStart[i] > 1)
+            {
+                struct meanNode same;
+                same.fileName1 = task->files[i]->fileName;
+                same.fileName2 = task->files[i]->fileName;
+                same.index1 = i;
+                same.index2 = i;
+                same.total = task->files[i]->numWords;
+                same.KLD1 = 0;
+                same.KLD2 = 0;
+                same.JSD = 0;
+
+                expandResult(worker, same);
+            }
+
+            int colStart = colBlock * TILE_SIZE;
+
+            if (colStart <= i)
+            {
+                colStart = i + 1;
+            }
+
+            if (colStart >= colEnd)
+            {
+                continue;
+            }
+
+            bool freshRow = (task->storeIndex[i] == -1);
+
+            if (!freshRow && !freshColumns)
+            {
+                for (int j = colStart; j < colEnd; j++)
+                {
+                    expandResult(worker, storedMean(task, i, j));
+                }
+
+                worker->copied += colEnd - colStart;
+                continue;
+            }
+
+            for (int slot = 0; slot < colEnd - colStart; slot++)
+            {
+                sum1[slot] = 0;
+                sum2[slot] = 0;
+                shared1[slot] = 0;
+                shared2[slot] = 0;
+                common[slot] = 0;
+            }
+
+            // Accumulating the shared words of the row file with every column file through the index
+
+            struct fileNode *filePtr = task->files[i];
+            block.n = 0;
+
+            for (int w = 0; w < filePtr->numWords; w++)
+            {
+                int id = filePtr->ids[w];
+
+                // Binary searching the posting list for the row file itself, which holds its probability
+
+                long lo = index->start[id];
+                long hi = index->start[id + 1];
+
+                while (lo < hi)
+                {
+                    long mid = lo + (hi - lo) / 2;
+
+                    if (index->file[mid] < i)
+                    {
+                        lo = mid + 1;
+                    }
+                    else
+                    {
+                        hi = mid;
+                    }
+                }
+
+                double prob = index->prob[lo];
+                double weight = index->weight[lo];
+
+                // Binary searching the rest of the list for the first file inside the tile's columns
+
+                lo++;
+                hi = index->start[id + 1];
+
+                while (lo < hi)
+                {
+                    long mid = lo + (hi - lo) / 2;
+
+                    if (index->file[mid] < colStart)
+                    {
+                        lo = mid + 1;
+                    }
+                    else
+                    {
+                        hi = mid;
+                    }
+                }
+
+                for (long post = lo; post < index->start[id + 1] && index->file[post] < colEnd; post++)
+                {
+                    int slot = index->file[post] - colStart;
+
+                    if (!freshRow && task->storeIndex[index->file[post]] != -1)
+                    {
+                        continue;
+                    }
+
+                    shared1[slot] += prob;
+                    shared2[slot] += index->prob[post];
+                    common[slot]++;
+
+                    if (pairKernel == NULL)
+                    {
+                        worker->terms++;
+                        continue;
+                    }
+
+                    block.prob1[block.n] = prob;
+                    block.prob2[block.n] = index->prob[post];
+                    block.weight1[block.n] = weight;
+                    block.weight2[block.n] = index->weight[post];
+                    block.slot[block.n] = slot;
+                    block.n++;
+
+                    if (block.n == KERNEL_BLOCK)
+                    {
+                        pairKernel(&block, sum1, sum2);
+                        worker->terms += block.n;
+                        block.n = 0;
+                    }
+                }
+            }
+
+            if (block.n > 0)
+            {
+                pairKernel(&block, sum1, sum2);
+                worker->terms += block.n;
+            }
+
+            for (int j = colStart; j < colEnd; j++)
+            {
+                int slot = j - colStart;
+
+                if (!freshRow && task->storeIndex[j] != -1)
+                {
+                    expandResult(worker, storedMean(task, i, j));
+                    worker->copied++;
+                    continue;
+                }
+
+                worker->computed++;
+                expandResult(worker, finishMean(filePtr, task->files[j], i, j, sum1[slot], sum2[slot], shared1[slot], shared2[slot], common[slot]));
+            }
+        }
+    }
+
+    flushStream(worker);
+
+    return 0;
+}
+
+/*
+ * expandResult() turns a mean node between two groups of identical files into one mean
+ * node for every pair of their files, and stores each with addResult(). The files keep the
+ * order of the file array, so the file that comes first is always fileName1, and its
+ * divergence KLD1. A mean node of a group with itself covers every pair inside the group.
+ * 
+ * @param struct pairWorker with the result buffer
+ * @param struct meanNode between the groups index1 and index2
+ * 
+ */
+
+void expandResult(struct pairWorker *worker, struct meanNode newMean)
+{
+    struct pairTask *task = worker->task;
+    int group1 = newMean.index1;
+    int group2 = newMean.index2;
+
+    for (int m1 = task->memberStart[group1]; m1 < task->memberStart[group1 + 1]; m1++)
+    {
+        int start = (group1 == group2) ? m1 + 1 : task->memberStart[group2];
+
+        for (int m2 = start; m2 < task->memberStart[group2 + 1]; m2++)
+        {
+            int file1 = task->members[m1];
+            int file2 = task->members[m2];
+            struct meanNode pairMean = newMean;
+
+            if (file1 > file2)
+            {
+                file1 = task->members[m2];
+                file2 = task->members[m1];
+                pairMean.KLD1 = newMean.KLD2;
+                pairMean.KLD2 = newMean.KLD1;
+            }
+
+            pairMean.index1 = file1;
+            pairMean.index2 = file2;
+            pairMean.fileName1 = task->allFiles[file1]->fileName;
+            pairMean.fileName2 = task->allFiles[file2]->fileName;
+
+            addResult(worker, pairMean);
+        }
+    }
+}
+
+/*
+ * addResult() stores a new mean node in a worker's result buffer.
+ * 
+ * Without a limit the buffer is a growing array. With --limit N it is a bounded heap
+ * of at most N mean nodes, see heapPush(). With --threshold T, mean nodes over T are
+ * dropped and the rest go to the worker's stream buffer, which is printed when full.
+ * 
+ * @param struct pairWorker with the result buffer
+ * @param struct meanNode to store
+ * 
+ */
+
+void addResult(struct pairWorker *worker, struct meanNode newMean)
+{
+    if (worker->task->threshold >= 0)
+    {
+        if (newMean.JSD <= worker->task->threshold)
+        {
+            worker->stream[worker->numStream++] = newMean;
+
+            if (worker->numStream == STREAM_BUFFER)
+            {
+                flushStream(worker);
+            }
+        }
+
+        return;
+    }
+
+    long limit = worker->task->limit;
+    long bound = (limit > 0) ? limit : worker->task->runLength;
+
+    if (worker->numResults == worker->capacity && (bound == 0 || worker->capacity < bound))
+    {
+        worker->capacity = (worker->capacity == 0) ? 64 : worker->capacity * 2;
+
+        if (bound > 0 && worker->capacity > bound)
+        {
+            worker->capacity = bound;
+        }
+
+        worker->results = (struct meanNode *)realloc(worker->results, sizeof(struct meanNode) * worker->capacity);
+
+        if (worker->results == NULL)
+        {
+            printf("Error: Failed to realloc results, exiting\n");
+            exit(0);
+        }
+    }
+
+    if (limit > 0)
+    {
+        heapPush(worker->results, &worker->numResults, limit, newMean);
+    }
+    else
+    {
+        if (worker->numResults == worker->capacity)
+        {
+            spillRun(worker);
+        }
+
+        worker->results[worker->numResults++] = newMean;
+    }
+}
+
+/*
+ * spillRun() sorts a worker's result buffer into report order and appends it to the
+ * --mem-limit spill file as one run, then empties the buffer.
+ * 
+ * Only what printing needs is written for each pair, the fields compareReport() looks at
+ * and the distance. The run's place in the file is taken under the task lock, so the
+ * workers write their runs at the same time without overlapping.
+ * 
+ * @param struct pairWorker with the result buffer
+ * 
+ */
+
+void spillRun(struct pairWorker *worker)
+{
+    struct spillRuns *runs = worker->task->runs;
+
+    if (worker->numResults == 0)
+    {
+        return;
+    }
+
+    qsort(worker->results, worker->numResults, sizeof(struct meanNode), compareReport);
+
+    // Taking the next records of the file for the run
+
+    pthread_mutex_lock(&worker->task->lock);
+
+    long first = runs->numRecords;
+    runs->numRecords += worker->numResults;
+
+    if (runs->numRuns == runs->capacity)
+    {
+        runs->capacity *= 2;
+        runs->runStart = (long *)realloc(runs->runStart, sizeof(long) * (runs->capacity + 1));
+    }
+
+    // Runs are laid out one after the other, so run r ends where run r + 1 starts
+
+    runs->runStart[runs->numRuns] = first;
+    runs->runStart[++runs->numRuns] = runs->numRecords;
+
+    pthread_mutex_unlock(&worker->task->lock);
+
+    // Writing the run a buffer of records at a time
+
+    struct spillRecord records[STREAM_BUFFER];
+
+    for (long r = 0; r < worker->numResults; r += STREAM_BUFFER)
+    {
+        long count = (worker->numResults - r < STREAM_BUFFER) ? worker->numResults - r : STREAM_BUFFER;
+
+        for (long c = 0; c < count; c++)
+        {
+            records[c].total = worker->results[r + c].total;
+            records[c].index1 = worker->results[r + c].index1;
+            records[c].index2 = worker->results[r + c].index2;
+            records[c].JSD = worker->results[r + c].JSD;
+        }
+
+        if (pwrite(runs->fd, records, sizeof(struct spillRecord) * count, sizeof(struct spillRecord) * (first + r)) != (ssize_t)(sizeof(struct spillRecord) * count))
+        {
+            printf("Error: Spill file cannot be written, exiting\n");
+            exit(0);
+        }
+    }
+
+    worker->numResults = 0;
+}
+
+/*
+ * mergeRuns() prints the runs written by spillRun() in report order.
+ * 
+ * The spill file is mapped into memory and every run is read from front to back, so the
+ * kernel can drop the pages already printed. A binary heap of the runs, ordered by the
+ * next record of each run, picks the record to print next, so only one record per run is
+ * looked at. Since compareReport() never finds two pairs equal, the output is the same as
+ * sorting everything at once.
+ * 
+ * @param struct args with the runs
+ * 
+ */
+
+void mergeRuns(struct args *argsParam)
+{
+    struct spillRuns *runs = argsParam->runs;
+
+    if (runs->numRecords == 0)
+    {
+        return;
+    }
+
+    size_t length = sizeof(struct spillRecord) * runs->numRecords;
+    struct spillRecord *records = (struct spillRecord *)mmap(NULL, length, PROT_READ, MAP_SHARED, runs->fd, 0);
+
+    if (records == MAP_FAILED)
+    {
+        printf("Error: Spill file cannot be read, exiting\n");
+        exit(0);
+    }
+
+    madvise(records, length, MADV_SEQUENTIAL);
+
+    // Building the heap of runs, each one at its first record
+
+    long *next = (long *)malloc(sizeof(long) * runs->numRuns);
+    long *heap = (long *)malloc(sizeof(long) * runs->numRuns);
+    long size = 0;
+
+    for (long r = 0; r < runs->numRuns; r++)
+    {
+        next[r] = runs->runStart[r];
+
+        long pos = size++;
+
+        while (pos > 0 && compareSpilled(&records[next[r]], &records[next[heap[(pos - 1) / 2]]]) < 0)
+        {
+            heap[pos] = heap[(pos - 1) / 2];
+            pos = (pos - 1) / 2;
+        }
+
+        heap[pos] = r;
+    }
+
+    while (size > 0)
+    {
+        // Printing the first record of the run on top and moving the run on to its next record
+
+        long top = heap[0];
+        struct spillRecord *record = &records[next[top]];
+
+        printMean(record->JSD, runs->files[record->index1]->fileName, runs->files[record->index2]->fileName);
+
+        if (++next[top] == runs->runStart[top + 1])
+        {
+            top = heap[--size];
+        }
+
+        // Sifting the run down to its place in the heap
+
+        long pos = 0;
+
+        while (size > 0)
+        {
+            long child = 2 * pos + 1;
+
+            if (child >= size)
+            {
+                break;
+            }
+
+            if (child + 1 < size && compareSpilled(&records[next[heap[child + 1]]], &records[next[heap[child]]]) < 0)
+            {
+                child++;
+            }
+
+            if (compareSpilled(&records[next[heap[child]]], &records[next[top]]) >= 0)
+            {
+                break;
+            }
+
+            heap[pos] = heap[child];
+            pos = child;
+        }
+
+        if (size > 0)
+        {
+            heap[pos] = top;
+        }
+    }
+
+    free(next);
+    free(heap);
+    munmap(records, length);
+}
+
+/*
+ * compareSpilled() orders two spilled records like compareReport() orders mean nodes.
+ * 
+ * @param two spilled records
+ * 
+ * @return negative if the first record is printed first, positive if it is printed after
+ * 
+ */
+
+int compareSpilled(const struct spillRecord *record1, const struct spillRecord *record2)
+{
+    if (record1->total != record2->total)
+    {
+        return (record1->total > record2->total) ? -1 : 1;
+    }
+
+    if (record1->index1 != record2->index1)
+    {
+        return (record1->index1 > record2->index1) ? -1 : 1;
+    }
+
+    if (record1->index2 != record2->index2)
+    {
+        return (record1->index2 > record2->index2) ? -1 : 1;
+    }
+
+    return 0;
+}
+
+/*
+ * spillTemp() creates a temporary file for --mem-limit in $TMPDIR, or /tmp without it.
+ * The file is unlinked right away, so it disappears with its last descriptor or mapping
+ * even if the run is interrupted.
+ * 
+ * @return descriptor of the empty file
+ * 
+ */
+
+int spillTemp(void)
+{
+    const char *dir = getenv("TMPDIR");
+
+    if (dir == NULL || dir[0] == '\0')
+    {
+        dir = "/tmp";
+    }
+
+    char *path = (char *)malloc(sizeof(char) * (strlen(dir) + 20));
+    strcpy(path, dir);
+    strcat(path, "/detector-XXXXXX");
+
+    int fd = mkstemp(path);
+
+    if (fd == -1)
+    {
+        printf("Error: Spill file cannot be created in [%s], exiting\n", dir);
+        exit(0);
+    }
+
+    unlink(path);
+    free(path);
+
+    return fd;
+}
+
+/*
+ * spillAlloc() allocates a large array. Under --mem-limit, the array is a shared mapping
+ * of its own temporary file, so its pages can be written out and dropped by the kernel
+ * like any file's instead of taking up memory or swap. Otherwise it comes from malloc().
+ * 
+ * @param struct args with the memory limit
+ * @param size_t length of the array in bytes
+ * 
+ * @return the array, to be freed with spillFree()
+ * 
+ */
+
+void *spillAlloc(struct args *argsParam, size_t length)
+{
+    if (argsParam->memLimit == 0)
+    {
+        return malloc(length);
+    }
+
+    // Mapping at least one byte, since an empty mapping is not allowed
+
+    length = (length == 0) ? 1 : length;
+
+    int fd = spillTemp();
+
+    if (ftruncate(fd, length) != 0)
+    {
+        printf("Error: Spill file cannot be written, exiting\n");
+        exit(0);
+    }
+
+    void *data = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (data == MAP_FAILED)
+    {
+        printf("Error: Spill file cannot be mapped, exiting\n");
+        exit(0);
+    }
+
+    return data;
+}
+
+/*
+ * spillFree() frees an array allocated by spillAlloc().
+ * 
+ * @param struct args with the memory limit
+ * @param void *data as the array, or NULL
+ * @param size_t length of the array in bytes, as passed to spillAlloc()
+ * 
+ */
+
+void spillFree(struct args *argsParam, void *data, size_t length)
+{
+    if (argsParam->memLimit == 0)
+    {
+        free(data);
+    }
+    else if (data != NULL)
+    {
+        munmap(data, (length == 0) ? 1 : length);
+    }
+}
+
+/*
+ * parseSize() reads a size in bytes, with an optional K, M or G suffix for powers of 1024.
+ * 
+ * @param const char *text to read
+ * 
+ * @return size in bytes, or -1 if the text is not a size
+ * 
+ */
+
+long parseSize(const char *text)
+{
+    char *end;
+    double size = strtod(text, &end);
+
+    if (end == text)
+    {
+        return -1;
+    }
+
+    if (*end == 'K' || *end == 'k')
+    {
+        size *= 1024;
+        end++;
+    }
+    else if (*end == 'M' || *end == 'm')
+    {
+        size *= 1024 * 1024;
+        end++;
+    }
+    else if (*end == 'G' || *end == 'g')
+    {
+        size *= 1024.0 * 1024 * 1024;
+        end++;
+    }
+
+    return (*end == '\0') ? (long)size : -1;
+}
+
+/*
+ * flushStream() prints the mean nodes in a worker's stream buffer and empties it.
+ * 
+ * The output lock keeps the lines of different workers from interleaving, and stdout
+ * is flushed right away so that the pairs show up while the analysis keeps running.
+ * 
+ * @param struct pairWorker with the stream buffer
+ * 
+ */
+
+void flushStream(struct pairWorker *worker)
+{
+    if (worker->numStream == 0)
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&worker->task->outputLock);
+
+    for (int m = 0; m < worker->numStream; m++)
+    {
+        printMean(worker->stream[m].JSD, worker->stream[m].fileName1, worker->stream[m].fileName2);
+    }
+
+    fflush(stdout);
+    pthread_mutex_unlock(&worker->task->outputLock);
+
+    worker->numStream = 0;
+}
+
+/*
+ * heapPush() adds a mean node to a bounded heap that keeps the first limit mean nodes
+ * in report order.
+ * 
+ * The heap is ordered so that the mean node printed last sits at the top. While the heap
+ * is not full, the new node is sifted up. Once it is full, the new node only replaces the
+ * top if it is printed before it, and is then sifted down, so every push is O(log limit).
+ * 
+ * @param struct meanNode *heap as the heap array with room for limit nodes
+ * @param long *size as the number of nodes in the heap
+ * @param long limit as the largest number of nodes kept
+ * @param struct meanNode to add
+ * 
+ */
+
+void heapPush(struct meanNode *heap, long *size, long limit, struct meanNode newMean)
+{
+    long pos;
+
+    if (*size < limit)
+    {
+        // Sifting the new node up from the bottom
+
+        pos = (*size)++;
+
+        while (pos > 0 && compareReport(&heap[(pos - 1) / 2], &newMean) < 0)
+        {
+            heap[pos] = heap[(pos - 1) / 2];
+            pos = (pos - 1) / 2;
+        }
+
+        heap[pos] = newMean;
+
+        return;
+    }
+
+    if (compareReport(&newMean, &heap[0]) >= 0)
+    {
+        return;
+    }
+
+    // Replacing the top and sifting the new node down
+
+    pos = 0;
+
+    while (true)
+    {
+        long child = 2 * pos + 1;
+
+        if (child >= *size)
+        {
+            break;
+        }
+
+        if (child + 1 < *size && compareReport(&heap[child], &heap[child + 1]) < 0)
+        {
+            child++;
+        }
+
+        if (compareReport(&newMean, &heap[child]) >= 0)
+        {
+            break;
+        }
+
+        heap[pos] = heap[child];
+        pos = child;
+    }
+
+    heap[pos] = newMean;
+}
+
+/*
+ * compare() calculates the Kullbek-Leibler Divergences between two files with each
+ * word entry and gets the Jensen-Shannon Distance. The value is stored in a new mean
+ * node so that the program can reference the values later.
+ * 
+ * A word that only one file contains has a mean probability of p / 2, so it always adds
+ * exactly p * log10(2) to that file's divergence. Since the probabilities of a file sum to
+ * 1, all of those words together add (1 - shared) * log10(2), where shared is the total
+ * probability of the words the file has in common with the other one. A file without
+ * words has no probabilities at all, so it adds nothing. For the words in
+ * common, p * log10(p / mean) = p * log10(p) - p * log10(mean). compare() is only used for
+ * the few candidate pairs of --topk, so p and p * log10(p) are worked out here from the
+ * counts, while analWorker() takes them precomputed from the inverted index. Either way
+ * the per-pair work is one log10(mean) per shared word, which is done in blocks of
+ * KERNEL_BLOCK words by pairKernel(), vectorized when the CPU allows it. The number of
+ * distinct words across both files is numWords1 + numWords2 - common.
+ * 
+ * The other metrics go through the same loop with their own weight of every word (see
+ * featureWeight()) and kernel, and finishMean() turns the sums into their distance.
+ * 
+ * @param struct fileNode *filePtr1 and *filePtr2 as the files to compare
+ * @param int index1 and index2 as the positions of the files in the file list
+ * 
+ * @return mean node of the pair
+ * 
+ */
+
+struct meanNode compare(struct fileNode *filePtr1, struct fileNode *filePtr2, int index1, int index2)
+{
+    int w1 = 0;
+    int w2 = 0;
+
+    struct kernelBlock block;
+    block.n = 0;
+
+    int metric = filePtr1->argsParam->metric;
+    double norm1 = fileNorm(metric, filePtr1);
+    double norm2 = fileNorm(metric, filePtr2);
+
+    double sum1 = 0;
+    double sum2 = 0;
+    double shared1 = 0;
+    double shared2 = 0;
+    int common = 0;
+
+    // Loops through both files sorted by word id and only keeps the words they have in common
+
+    while (w1 < filePtr1->numWords && w2 < filePtr2->numWords)
+    {
+        if (filePtr1->ids[w1] < filePtr2->ids[w2])
+        {
+            w1++;
+        }
+        else if (filePtr1->ids[w1] > filePtr2->ids[w2])
+        {
+            w2++;
+        }
+        else
+        {
+            double prob1 = (double)filePtr1->counts[w1] / filePtr1->total;
+            double prob2 = (double)filePtr2->counts[w2] / filePtr2->total;
+
+            shared1 += prob1;
+            shared2 += prob2;
+            common++;
+
+            w1++;
+            w2++;
+
+            if (pairKernel == NULL)
+            {
+                continue;
+            }
+
+            block.prob1[block.n] = prob1;
+            block.prob2[block.n] = prob2;
+            block.weight1[block.n] = featureWeight(metric, prob1, norm1);
+            block.weight2[block.n] = featureWeight(metric, prob2, norm2);
+            block.slot[block.n] = 0;
+            block.n++;
+
+            if (block.n == KERNEL_BLOCK)
+            {
+                pairKernel(&block, &sum1, &sum2);
+                block.n = 0;
+            }
+        }
+    }
+
+    if (block.n > 0)
+    {
+        pairKernel(&block, &sum1, &sum2);
+    }
+
+    return finishMean(filePtr1, filePtr2, index1, index2, sum1, sum2, shared1, shared2, common);
+}
+
+/*
+ * finishMean() turns the sums over the shared words of two files into a new mean node,
+ * with the distance of the --metric in the place of the Jensen-Shannon Distance.
+ * 
+ * For JSD, the words that only one of the files contains are added here in closed form.
+ * Cosine and Hellinger only need the sum of the products of the weights, the cosine
+ * similarity and the Bhattacharyya coefficient, which become the distances
+ * 1 - cosine and sqrt(1 - coefficient). Jaccard only needs the number of shared words.
+ * The symmetric metrics store their distance as both divergences. The number of distinct
+ * words across both files is numWords1 + numWords2 - common.
+ * 
+ * @param struct fileNode *filePtr1 and *filePtr2 as the files compared
+ * @param int index1 and index2 as the positions of the files in the file list
+ * @param double sum1 and sum2 as the kernel's sums over the shared words
+ * @param double shared1 and shared2 as the probability of the shared words in each file
+ * @param int common as the number of shared words
+ * 
+ * @return mean node of the pair
+ * 
+ */
+
+struct meanNode finishMean(struct fileNode *filePtr1, struct fileNode *filePtr2, int index1, int index2, double sum1, double sum2, double shared1, double shared2, int common)
+{
+    int distinct = filePtr1->numWords + filePtr2->numWords - common;
+    double KLD1;
+    double KLD2;
+
+    switch (filePtr1->argsParam->metric)
+    {
+        case METRIC_COSINE:
+            KLD1 = 1 - sum1;
+            KLD2 = KLD1;
+            break;
+
+        case METRIC_JACCARD:
+            KLD1 = (distinct == 0) ? 0 : 1 - (double)common / distinct;
+            KLD2 = KLD1;
+            break;
+
+        case METRIC_HELLINGER:
+            KLD1 = (sum1 > 1) ? 0 : sqrt(1 - sum1);
+            KLD2 = KLD1;
+            break;
+
+        default:
+            // Adding the words that only one of the files contains, none for a file without words
+
+            KLD1 = sum1 + ((filePtr1->numWords > 0) ? (1 - shared1) * log10(2) : 0);
+            KLD2 = sum2 + ((filePtr2->numWords > 0) ? (1 - shared2) * log10(2) : 0);
+            break;
+    }
+
+    // Distances are never negative, but rounding can leave identical files a hair below 0
+
+    KLD1 = (KLD1 < 0) ? 0 : KLD1;
+    KLD2 = (KLD2 < 0) ? 0 : KLD2;
+
+    // Initializing a new mean node
+
+    struct meanNode newMean;
+    newMean.fileName1 = filePtr1->fileName;
+    newMean.fileName2 = filePtr2->fileName;
+    newMean.index1 = index1;
+    newMean.index2 = index2;
+    newMean.total = distinct;
+    newMean.KLD1 = KLD1;
+    newMean.KLD2 = KLD2;
+    newMean.JSD = (newMean.KLD1 + newMean.KLD2) / 2;
+
+    return newMean;
+}
+
+/*
+ * featureWeight() is the weight of a word of a file that the kernel of the --metric
+ * works with: p * log10(p) for JSD, p divided by the norm of the file for cosine, so that
+ * the sum of the products is the cosine similarity, and sqrt(p) for Hellinger. Jaccard
+ * does not use the kernel.
+ * 
+ * @param int metric as the --metric
+ * @param double prob as the probability of the word in the file
+ * @param double norm as the fileNorm() of the file
+ * 
+ * @return weight of the word
+ * 
+ */
+
+double featureWeight(int metric, double prob, double norm)
+{
+    switch (metric)
+    {
+        case METRIC_COSINE:
+            return prob / norm;
+
+        case METRIC_HELLINGER:
+            return sqrt(prob);
+
+        case METRIC_JACCARD:
+            return 0;
+
+        default:
+            return prob * log10(prob);
+    }
+}
+
+/*
+ * fileNorm() is the Euclidean norm of the probabilities of a file for cosine, and 1 for
+ * every other metric.
+ * 
+ * @param int metric as the --metric
+ * @param struct fileNode of the file
+ * 
+ * @return norm of the file
+ * 
+ */
+
+double fileNorm(int metric, struct fileNode *filePtr)
+{
+    if (metric != METRIC_COSINE || filePtr->total == 0)
+    {
+        return 1;
+    }
+
+    double squares = 0;
+
+    for (int w = 0; w < filePtr->numWords; w++)
+    {
+        squares += (double)filePtr->counts[w] * filePtr->counts[w];
+    }
+
+    return sqrt(squares) / filePtr->total;
+}
+
+/*
+ * buildIndex() builds the inverted index used by analWorker(). Every word id gets a
+ * posting list of the files that contain it, with the word's probability and its
+ * featureWeight() for the --metric in that file.
+ * 
+ * The probabilities are worked out from the shared count arrays here, once per file and
+ * word, and the index is the only place they are kept.
+ * 
+ * All posting lists live in the same arrays, one after the other, and the list of word
+ * id w runs from start[w] to start[w + 1]. The files are added in index order, so every
+ * posting list is sorted by file index and can be binary searched. Under --mem-limit,
+ * the posting arrays live in temporary files like the word arrays.
+ * 
+ * @param struct args with the vocabulary size
+ * @param struct pairTask with the file array and the index to fill in
+ * 
+ */
+
+void buildIndex(struct args *argsParam, struct pairTask *task)
+{
+    struct invertedIndex *index = &task->index;
+
+    // Counting the files of every word, then turning the counts into starting positions
+
+    index->start = (long *)calloc(argsParam->vocabSize + 1, sizeof(long));
+
+    for (int i = 0; i < task->numFiles; i++)
+    {
+        for (int w = 0; w < task->files[i]->numWords; w++)
+        {
+            index->start[task->files[i]->ids[w] + 1]++;
+        }
+    }
+
+    for (int w = 0; w < argsParam->vocabSize; w++)
+    {
+        index->start[w + 1] += index->start[w];
+    }
+
+    long numPostings = index->start[argsParam->vocabSize];
+
+    index->numPostings = numPostings + 1;
+    index->file = (int *)spillAlloc(argsParam, sizeof(int) * index->numPostings);
+    index->prob = (double *)spillAlloc(argsParam, sizeof(double) * index->numPostings);
+    index->weight = (double *)spillAlloc(argsParam, sizeof(double) * index->numPostings);
+
+    // Filling in the posting lists, using a copy of the starting positions as the next free slot
+
+    long *next = (long *)malloc(sizeof(long) * (argsParam->vocabSize + 1));
+    memcpy(next, index->start, sizeof(long) * (argsParam->vocabSize + 1));
+
+    for (int i = 0; i < task->numFiles; i++)
+    {
+        double norm = fileNorm(argsParam->metric, task->files[i]);
+
+        for (int w = 0; w < task->files[i]->numWords; w++)
+        {
+            struct fileNode *filePtr = task->files[i];
+            long post = next[filePtr->ids[w]]++;
+
+            index->file[post] = i;
+            index->prob[post] = (double)filePtr->counts[w] / filePtr->total;
+            index->weight[post] = featureWeight(argsParam->metric, index->prob[post], norm);
+        }
+    }
+
+    free(next);
+}
+
+/*
+ * compareReport() is the qsort() comparator that puts mean nodes in the order they are
+ * printed: decreasing number of distinct words compared, and among equal counts, the pair
+ * that comes later when walking the file list sequentially goes first.
+ * 
+ * @param pointers to two mean nodes
+ * 
+ * @return negative if the first mean node is printed first, positive if it is printed after
+ * 
+ */
+
+int compareReport(const void *a, const void *b)
+{
+    const struct meanNode *mean1 = (const struct meanNode *)a;
+    const struct meanNode *mean2 = (const struct meanNode *)b;
+
+    if (mean1->total != mean2->total)
+    {
+        return (mean1->total > mean2->total) ? -1 : 1;
+    }
+
+    if (mean1->index1 != mean2->index1)
+    {
+        return (mean1->index1 > mean2->index1) ? -1 : 1;
+    }
+
+    if (mean1->index2 != mean2->index2)
+    {
+        return (mean1->index2 > mean2->index2) ? -1 : 1;
+    }
+
+    return 0;
+}
+
+/*
+ * selectKernel() picks the fastest divergence, dot product and tokenizer kernels that the
+ * current CPU supports, the pair kernel of the --metric, and builds the tokenizer's class
+ * table.
+ * 
+ * AVX2 is checked at runtime, so one binary works on every x86 machine. SSE2 is part of
+ * every x86-64 CPU, and every other architecture falls back to the scalar kernels.
+ * 
+ * The class table is built from isspace() and isalpha() of the C locale the program runs
+ * in, and marks each byte as whitespace, as a valid character of a word (letters and
+ * dashes), or neither. The vector kernels test the same ASCII ranges directly.
+ * 
+ * @param int metric as the --metric
+ * 
+ */
+
+void selectKernel(int metric)
+{
+    for (int c = 0; c < 256; c++)
+    {
+        char byte = (char)c;
+
+        charClass[c] = (isspace(byte) ? CLASS_SPACE : 0) | ((isalpha(byte) || byte == '-') ? CLASS_WORD : 0);
+    }
+
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+
+    if (__builtin_cpu_supports("avx2"))
+    {
+        divergenceKernel = divergenceAVX2;
+        dotKernel = dotAVX2;
+        scanKernel = scanAVX2;
+        lowerKernel = lowerAVX2;
+    }
+    else if (__builtin_cpu_supports("sse2"))
+    {
+        divergenceKernel = divergenceSSE2;
+        dotKernel = dotSSE2;
+        scanKernel = scanSSE2;
+        lowerKernel = lowerSSE2;
+    }
+#endif
+
+    // Cosine and Hellinger both add up products of weights, and Jaccard only counts
+
+    if (metric == METRIC_JSD)
+    {
+        pairKernel = divergenceKernel;
+    }
+    else if (metric == METRIC_JACCARD)
+    {
+        pairKernel = NULL;
+    }
+    else
+    {
+        pairKernel = dotKernel;
+    }
+}
+
+/*
+ * divergenceScalar() adds the Kullbek-Leibler Divergence terms of a block of shared
+ * words to the running sums of both files.
+ * 
+ * For every word, the mean probability is the average of both files, and each file
+ * adds p * log10(p / mean), computed as the precomputed p * log10(p) minus p * log10(mean).
+ * A block can hold words of several file pairs, and the terms of each word are added to
+ * the running sums at position slot.
+ * 
+ * @param struct kernelBlock with the probabilities and p * log10(p) terms of each file
+ * @param double *KLD1 and *KLD2 as the running sums of every slot
+ * 
+ */
+
+void divergenceScalar(const struct kernelBlock *block, double *KLD1, double *KLD2)
+{
+    for (int i = 0; i < block->n; i++)
+    {
+        double logMean = log10((block->prob1[i] + block->prob2[i]) / 2);
+
+        KLD1[block->slot[i]] += block->weight1[i] - block->prob1[i] * logMean;
+        KLD2[block->slot[i]] += block->weight2[i] - block->prob2[i] * logMean;
+    }
+}
+
 /*
- * main() is the driver function that calls each function in the program in order to calculate
- * the Jensen-Shannon Distance.
- * 
- * The function first checks if the paramters are valid, including a directory that can be opened.
- * It will then initialize the initial args struct so that each thread created can use the shared
- * linked lists. After each file is read, the function will sort the file linked list in decreasing
- * number of tokens. It will analyze the files and calculate the Jensen-Shannon Distance between each
- * file and put the result in the mean linked list. It will then sort the mean linked list by increasing
- * number of tokens. Finally, it will print out each Jensen-Shannon Distance color-coded and then free all
- * the allocated memory.
+ * dotScalar() adds the products of the weights of a block of shared words to the running
+ * sums of their slots, which is all that cosine and Hellinger need from the shared words.
  * 
- * @param int argc and char *argv[] as terminal inputs
+ * @param struct kernelBlock with the weights of each file
+ * @param double *sum1 as the running sums of every slot
+ * @param double *sum2 unused, to match the divergence kernels
  * 
  */
 
-int main(int argc, char *argv[])
+void dotScalar(const struct kernelBlock *block, double *sum1, double *sum2)
 {
-    // Verifying correct number of arguments passed in
-
-    if (argc != 2)
+    for (int i = 0; i < block->n; i++)
     {
-        printf("Error: No arguments passed in\nPlease enter a base directory\n");
-        exit(0);
+        sum1[block->slot[i]] += block->weight1[i] * block->weight2[i];
     }
+}
 
-    // Verifying that the passed in directory can be opened
+#if defined(__x86_64__) || defined(__i386__)
 
-    DIR *dir;
-    dir = opendir(argv[1]);
+/*
+ * The vectorized kernels compute log10 themselves instead of calling libm for each lane.
+ * 
+ * A positive double x is split into 2^e * m with m in [sqrt(1/2), sqrt(2)), then
+ * ln(m) = 2 * atanh(s) with s = (m - 1) / (m + 1). Since |s| < 0.172, the odd series of
+ * atanh up to s^17 is already accurate to about 1e-16, which is as good as libm for the
+ * values that show up here. The mean probability of a shared word is never 0 or denormal.
+ * 
+ */
 
-    if (dir == NULL)
-    {
-        printf("Error: Base directory cannot be opened, exiting\n");
-        exit(0);
-    }
+#define LOG_C1 (2.0 / 3.0)
+#define LOG_C2 (2.0 / 5.0)
+#define LOG_C3 (2.0 / 7.0)
+#define LOG_C4 (2.0 / 9.0)
+#define LOG_C5 (2.0 / 11.0)
+#define LOG_C6 (2.0 / 13.0)
+#define LOG_C7 (2.0 / 15.0)
+#define LOG_C8 (2.0 / 17.0)
+#define LN2 0.69314718055994530942
+#define INV_LN10 0.43429448190325182765
+
+static inline __m128d log10SSE2(__m128d x)
+{
+    const __m128i mantissaMask = _mm_set1_epi64x(0x000FFFFFFFFFFFFFLL);
+    const __m128i one = _mm_set1_epi64x(0x3FF0000000000000LL);
+    const __m128i magic = _mm_set1_epi64x(0x4330000000000000LL);
 
-    closedir(dir);
+    // Splitting x into its biased exponent (as a double) and a mantissa in [1, 2)
 
-    // Initial args struct initialization
+    __m128i bits = _mm_castpd_si128(x);
+    __m128d exponent = _mm_sub_pd(_mm_castsi128_pd(_mm_or_si128(_mm_srli_epi64(bits, 52), magic)), _mm_set1_pd(4503599627370496.0 + 1023.0));
+    __m128d m = _mm_castsi128_pd(_mm_or_si128(_mm_and_si128(bits, mantissaMask), one));
 
-    struct args *initialArgs = (struct args *)malloc(sizeof(struct args));
-    initialArgs->fileHead = NULL;
-    initialArgs->meanHead = NULL;
-    initialArgs->baseDir = argv[1];
+    // Moving mantissas above sqrt(2) down by one octave so that m is centered on 1
 
-    // Initializing the mutex in the args struct
+    __m128d big = _mm_cmpgt_pd(m, _mm_set1_pd(1.41421356237309504880));
+    m = _mm_or_pd(_mm_and_pd(big, _mm_mul_pd(m, _mm_set1_pd(0.5))), _mm_andnot_pd(big, m));
+    exponent = _mm_add_pd(exponent, _mm_and_pd(big, _mm_set1_pd(1.0)));
 
-    if (pthread_mutex_init(&initialArgs->lock, NULL) != 0)
-    {
-        printf("Error: Mutex initialization failed, exiting");
-        exit(0);
-    }
+    __m128d t = _mm_div_pd(_mm_sub_pd(m, _mm_set1_pd(1.0)), _mm_add_pd(m, _mm_set1_pd(1.0)));
+    __m128d t2 = _mm_mul_pd(t, t);
+
+    __m128d poly = _mm_set1_pd(LOG_C8);
+    poly = _mm_add_pd(_mm_mul_pd(poly, t2), _mm_set1_pd(LOG_C7));
+    poly = _mm_add_pd(_mm_mul_pd(poly, t2), _mm_set1_pd(LOG_C6));
+    poly = _mm_add_pd(_mm_mul_pd(poly, t2), _mm_set1_pd(LOG_C5));
+    poly = _mm_add_pd(_mm_mul_pd(poly, t2), _mm_set1_pd(LOG_C4));
+    poly = _mm_add_pd(_mm_mul_pd(poly, t2), _mm_set1_pd(LOG_C3));
+    poly = _mm_add_pd(_mm_mul_pd(poly, t2), _mm_set1_pd(LOG_C2));
+    poly = _mm_add_pd(_mm_mul_pd(poly, t2), _mm_set1_pd(LOG_C1));
+    poly = _mm_add_pd(_mm_mul_pd(poly, t2), _mm_set1_pd(2.0));
 
-    // Calling readDirectory() to read all the files and create the necessary threads
+    __m128d ln = _mm_add_pd(_mm_mul_pd(exponent, _mm_set1_pd(LN2)), _mm_mul_pd(poly, t));
 
-    readDirectory(initialArgs);
+    return _mm_mul_pd(ln, _mm_set1_pd(INV_LN10));
+}
 
-    // Verifying that there is data written to the file linked list
+/*
+ * divergenceSSE2() is divergenceScalar() two words at a time.
+ * 
+ */
 
-    struct fileNode *ptr = initialArgs->fileHead;
+void divergenceSSE2(const struct kernelBlock *block, double *KLD1, double *KLD2)
+{
+    __m128d half = _mm_set1_pd(0.5);
+    double lanes1[2];
+    double lanes2[2];
+    int i = 0;
 
-    if (ptr == NULL)
+    for (; i + 2 <= block->n; i += 2)
     {
-        printf("Error: No data, exiting\n");
-        exit(0);
+        __m128d p = _mm_loadu_pd(block->prob1 + i);
+        __m128d q = _mm_loadu_pd(block->prob2 + i);
+        __m128d logMean = log10SSE2(_mm_mul_pd(_mm_add_pd(p, q), half));
+
+        _mm_storeu_pd(lanes1, _mm_sub_pd(_mm_loadu_pd(block->weight1 + i), _mm_mul_pd(p, logMean)));
+        _mm_storeu_pd(lanes2, _mm_sub_pd(_mm_loadu_pd(block->weight2 + i), _mm_mul_pd(q, logMean)));
+
+        for (int k = 0; k < 2; k++)
+        {
+            KLD1[block->slot[i + k]] += lanes1[k];
+            KLD2[block->slot[i + k]] += lanes2[k];
+        }
     }
 
-    // Joining the threads so that all threads can finish
 
-    struct fileNode *filePtr = initialArgs->fileHead;
+    // The odd word left over goes through the scalar formula
 
-    while (filePtr != NULL)
+    for (; i < block->n; i++)
     {
-        pthread_join(filePtr->id, NULL);
-        filePtr = filePtr->next;
+        double logMean = log10((block->prob1[i] + block->prob2[i]) / 2);
+
+        KLD1[block->slot[i]] += block->weight1[i] - block->prob1[i] * logMean;
+        KLD2[block->slot[i]] += block->weight2[i] - block->prob2[i] * logMean;
     }
+}
 
-    // Soring the file nodes in decreasing order
+__attribute__((target("avx2"))) static inline __m256d log10AVX2(__m256d x)
+{
+    const __m256i mantissaMask = _mm256_set1_epi64x(0x000FFFFFFFFFFFFFLL);
+    const __m256i one = _mm256_set1_epi64x(0x3FF0000000000000LL);
+    const __m256i magic = _mm256_set1_epi64x(0x4330000000000000LL);
 
-    mergeSort(&initialArgs->fileHead);
+    // Splitting x into its biased exponent (as a double) and a mantissa in [1, 2)
 
-    // Analyzing each file and calculating the Jensen-Shannon Distance between each file
+    __m256i bits = _mm256_castpd_si256(x);
+    __m256d exponent = _mm256_sub_pd(_mm256_castsi256_pd(_mm256_or_si256(_mm256_srli_epi64(bits, 52), magic)), _mm256_set1_pd(4503599627370496.0 + 1023.0));
+    __m256d m = _mm256_castsi256_pd(_mm256_or_si256(_mm256_and_si256(bits, mantissaMask), one));
 
-    anal(initialArgs);
+    // Moving mantissas above sqrt(2) down by one octave so that m is centered on 1
 
-    // Printing the results
+    __m256d big = _mm256_cmp_pd(m, _mm256_set1_pd(1.41421356237309504880), _CMP_GT_OQ);
+    m = _mm256_blendv_pd(m, _mm256_mul_pd(m, _mm256_set1_pd(0.5)), big);
+    exponent = _mm256_add_pd(exponent, _mm256_and_pd(big, _mm256_set1_pd(1.0)));
 
-    printing(initialArgs);
+    __m256d t = _mm256_div_pd(_mm256_sub_pd(m, _mm256_set1_pd(1.0)), _mm256_add_pd(m, _mm256_set1_pd(1.0)));
+    __m256d t2 = _mm256_mul_pd(t, t);
 
-    // Freeing the allocated memory
+    __m256d poly = _mm256_set1_pd(LOG_C8);
+    poly = _mm256_add_pd(_mm256_mul_pd(poly, t2), _mm256_set1_pd(LOG_C7));
+    poly = _mm256_add_pd(_mm256_mul_pd(poly, t2), _mm256_set1_pd(LOG_C6));
+    poly = _mm256_add_pd(_mm256_mul_pd(poly, t2), _mm256_set1_pd(LOG_C5));
+    poly = _mm256_add_pd(_mm256_mul_pd(poly, t2), _mm256_set1_pd(LOG_C4));
+    poly = _mm256_add_pd(_mm256_mul_pd(poly, t2), _mm256_set1_pd(LOG_C3));
+    poly = _mm256_add_pd(_mm256_mul_pd(poly, t2), _mm256_set1_pd(LOG_C2));
+    poly = _mm256_add_pd(_mm256_mul_pd(poly, t2), _mm256_set1_pd(LOG_C1));
+    poly = _mm256_add_pd(_mm256_mul_pd(poly, t2), _mm256_set1_pd(2.0));
 
-    freeing(initialArgs);
+    __m256d ln = _mm256_add_pd(_mm256_mul_pd(exponent, _mm256_set1_pd(LN2)), _mm256_mul_pd(poly, t));
 
-    return 0;
+    return _mm256_mul_pd(ln, _mm256_set1_pd(INV_LN10));
 }
 
 /*
- * readDirectory() goes through the specified directory, finds all the files, 
- * and creates the necessary threads.
- * 
- * The function first finds the matching directory that the current thread is
- * working with. It attempts to open the directory, and returns an error if the
- * directory cannot be opened. It will then loop through the directory, and create
- * new threads for all the valid files found and add a new file node with the
- * corresponding thread id.
- * 
- * @param struct args with the shared linked lists
+ * divergenceAVX2() is divergenceScalar() four words at a time.
  * 
  */
 
-void *readDirectory(struct args *argsParam)
+__attribute__((target("avx2"))) void divergenceAVX2(const struct kernelBlock *block, double *KLD1, double *KLD2)
 {
-    // Finds the current directory and thread that the current thread is working with
-
-    struct fileNode *tempFile = findThread(argsParam);
+    __m256d half = _mm256_set1_pd(0.5);
+    double lanes1[4];
+    double lanes2[4];
+    int i = 0;
 
-    // Copies the directory name so that the method knows what directory it is working with
+    for (; i + 4 <= block->n; i += 4)
+    {
+        __m256d p = _mm256_loadu_pd(block->prob1 + i);
+        __m256d q = _mm256_loadu_pd(block->prob2 + i);
+        __m256d logMean = log10AVX2(_mm256_mul_pd(_mm256_add_pd(p, q), half));
 
-    int dirLength = 0;
+        _mm256_storeu_pd(lanes1, _mm256_sub_pd(_mm256_loadu_pd(block->weight1 + i), _mm256_mul_pd(p, logMean)));
+        _mm256_storeu_pd(lanes2, _mm256_sub_pd(_mm256_loadu_pd(block->weight2 + i), _mm256_mul_pd(q, logMean)));
 
-    if (tempFile != NULL)
-    {
-        dirLength = strlen(tempFile->fileName) + 1;
+        for (int k = 0; k < 4; k++)
+        {
+            KLD1[block->slot[i + k]] += lanes1[k];
+            KLD2[block->slot[i + k]] += lanes2[k];
+        }
     }
-    else
+
+    // The words left over go through the scalar formula
+
+    for (; i < block->n; i++)
     {
-        dirLength = strlen(argsParam->baseDir) + 1;
+        double logMean = log10((block->prob1[i] + block->prob2[i]) / 2);
+
+        KLD1[block->slot[i]] += block->weight1[i] - block->prob1[i] * logMean;
+        KLD2[block->slot[i]] += block->weight2[i] - block->prob2[i] * logMean;
     }
+}
+
+/*
+ * dotSSE2() and dotAVX2() are dotScalar() two and four words at a time.
+ * 
+ */
 
-    char baseDir[dirLength];
+void dotSSE2(const struct kernelBlock *block, double *sum1, double *sum2)
+{
+    double lanes[2];
+    int i = 0;
 
-    if (tempFile != NULL)
+    for (; i + 2 <= block->n; i += 2)
     {
-        strcpy(baseDir, tempFile->fileName);
+        _mm_storeu_pd(lanes, _mm_mul_pd(_mm_loadu_pd(block->weight1 + i), _mm_loadu_pd(block->weight2 + i)));
+
+        sum1[block->slot[i]] += lanes[0];
+        sum1[block->slot[i + 1]] += lanes[1];
     }
-    else
+
+    for (; i < block->n; i++)
     {
-        strcpy(baseDir, argsParam->baseDir);
+        sum1[block->slot[i]] += block->weight1[i] * block->weight2[i];
     }
+}
 
-    // Verify that the current directory can be opened
-    // Initializes the dirent and dir variables so that all files in the directory can be found
+__attribute__((target("avx2"))) void dotAVX2(const struct kernelBlock *block, double *sum1, double *sum2)
+{
+    double lanes[4];
+    int i = 0;
 
-    struct dirent *dirent;
-    DIR *dir;
-    dir = opendir(baseDir);
+    for (; i + 4 <= block->n; i += 4)
+    {
+        _mm256_storeu_pd(lanes, _mm256_mul_pd(_mm256_loadu_pd(block->weight1 + i), _mm256_loadu_pd(block->weight2 + i)));
 
-    if (dir == NULL)
+        for (int k = 0; k < 4; k++)
+        {
+            sum1[block->slot[i + k]] += lanes[k];
+        }
+    }
+
+    for (; i < block->n; i++)
     {
-        printf("Error: [%s] directory cannot be opened, returning\n", baseDir);
-        return 0;
+        sum1[block->slot[i]] += block->weight1[i] * block->weight2[i];
     }
+}
 
-    // Looping through all the file in the current directory
+/*
+ * scanSSE2() is scanScalar() sixteen characters at a time.
+ * 
+ * Whitespace is a space or a byte from 9 to 13, and a valid character is a letter of
+ * either case or a dash. Both are found with comparisons on the whole vector, and the
+ * first whitespace is the lowest bit of the whitespace mask.
+ * 
+ */
 
-    while ((dirent = readdir(dir)) != NULL)
+size_t scanSSE2(const char *data, size_t pos, size_t length, bool *clean)
+{
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i tab = _mm_set1_epi8(9);
+    const __m128i four = _mm_set1_epi8(4);
+    const __m128i lowerBit = _mm_set1_epi8(0x20);
+    const __m128i letterA = _mm_set1_epi8('a');
+    const __m128i letters = _mm_set1_epi8(25);
+    const __m128i dash = _mm_set1_epi8('-');
+
+    while (pos + 16 <= length)
     {
-        char *fileName = dirent->d_name;
+        __m128i bytes = _mm_loadu_si128((const __m128i *)(data + pos));
+
+        // Bytes 9 to 13 are the ones that are at most 4 once 9 is taken away, compared unsigned
+
+        __m128i control = _mm_sub_epi8(bytes, tab);
+        __m128i isSpace = _mm_or_si128(_mm_cmpeq_epi8(bytes, space), _mm_cmpeq_epi8(_mm_min_epu8(control, four), control));
+
+        __m128i letter = _mm_sub_epi8(_mm_or_si128(bytes, lowerBit), letterA);
+        __m128i isWord = _mm_or_si128(_mm_cmpeq_epi8(_mm_min_epu8(letter, letters), letter), _mm_cmpeq_epi8(bytes, dash));
 
-        // Skips the "." and ".." files in each directory
+        unsigned spaceMask = _mm_movemask_epi8(isSpace);
+        unsigned wordMask = _mm_movemask_epi8(isWord);
 
-        if (strcmp(fileName, ".") != 0 && strcmp(fileName, "..") != 0)
+        if (spaceMask != 0)
         {
-            // Skips all files that are not a directory or files with ASCII text
+            int end = __builtin_ctz(spaceMask);
 
-            if (dirent->d_type == DT_DIR || dirent->d_type == DT_REG)
+            if ((~wordMask & ((1u << end) - 1)) != 0)
             {
-                // Initializing a new file node
+                *clean = false;
+            }
 
-                struct fileNode *newFile = (struct fileNode *)malloc(sizeof(struct fileNode));
-                newFile->total = 0;
-                newFile->wordHead = NULL;
-                newFile->folder = false;
-                newFile->next = NULL;
+            return pos + end;
+        }
 
-                newFile->fileName = (char *)malloc(sizeof(char) * (strlen(baseDir) + strlen(fileName) + 2));
+        if (wordMask != 0xFFFF)
+        {
+            *clean = false;
+        }
 
-                strcpy(newFile->fileName, baseDir);
-                strcat(newFile->fileName, "/");
-                strcat(newFile->fileName, fileName);
+        pos += 16;
+    }
 
-                pthread_mutex_lock(&argsParam->lock);
+    return scanScalar(data, pos, length, clean);
+}
 
-                if (argsParam->fileHead == NULL)
-                {
-                    argsParam->fileHead = newFile;
-                }
-                else
-                {
-                    struct fileNode *ptr = argsParam->fileHead;
+/*
+ * scanAVX2() is scanSSE2() thirty-two characters at a time.
+ * 
+ */
 
-                    while (ptr->next != NULL)
-                    {
-                        ptr = ptr->next;
-                    }
+__attribute__((target("avx2"))) size_t scanAVX2(const char *data, size_t pos, size_t length, bool *clean)
+{
+    const __m256i space = _mm256_set1_epi8(' ');
+    const __m256i tab = _mm256_set1_epi8(9);
+    const __m256i four = _mm256_set1_epi8(4);
+    const __m256i lowerBit = _mm256_set1_epi8(0x20);
+    const __m256i letterA = _mm256_set1_epi8('a');
+    const __m256i letters = _mm256_set1_epi8(25);
+    const __m256i dash = _mm256_set1_epi8('-');
+
+    while (pos + 32 <= length)
+    {
+        __m256i bytes = _mm256_loadu_si256((const __m256i *)(data + pos));
 
-                    ptr->next = newFile;
-                }
+        __m256i control = _mm256_sub_epi8(bytes, tab);
+        __m256i isSpace = _mm256_or_si256(_mm256_cmpeq_epi8(bytes, space), _mm256_cmpeq_epi8(_mm256_min_epu8(control, four), control));
 
-                pthread_mutex_unlock(&argsParam->lock);
+        __m256i letter = _mm256_sub_epi8(_mm256_or_si256(bytes, lowerBit), letterA);
+        __m256i isWord = _mm256_or_si256(_mm256_cmpeq_epi8(_mm256_min_epu8(letter, letters), letter), _mm256_cmpeq_epi8(bytes, dash));
 
-                if (dirent->d_type == DT_DIR)
-                {
-                    // If the file found is a directory, a new thread is created and recurses
+        uint32_t spaceMask = _mm256_movemask_epi8(isSpace);
+        uint32_t wordMask = _mm256_movemask_epi8(isWord);
 
-                    newFile->folder = true;
+        if (spaceMask != 0)
+        {
+            int end = __builtin_ctz(spaceMask);
 
-                    void *(*readDir)();
-                    readDir = readDirectory;
+            if ((~wordMask & (uint32_t)((1ull << end) - 1)) != 0)
+            {
+                *clean = false;
+            }
 
-                    int err = pthread_create(&newFile->id, NULL, readDir, argsParam);
+            return pos + end;
+        }
 
-                    if (err != 0)
-                    {
-                        printf("Error: Creating thread unsuccessful, exiting\n");
-                        exit(0);
-                    }
-                }
-                else if (dirent->d_type == DT_REG)
-                {
-                    // If the file found is a ASCII text file, a new thread is created and calls tokenize() to read file contents
+        if (wordMask != 0xFFFFFFFF)
+        {
+            *clean = false;
+        }
 
-                    void *(*token)();
-                    token = tokenize;
+        pos += 32;
+    }
 
-                    int err = pthread_create(&newFile->id, NULL, token, argsParam);
+    return scanSSE2(data, pos, length, clean);
+}
 
-                    if (err != 0)
-                    {
-                        printf("Error: Creating thread unsuccessful, exiting\n");
-                        exit(0);
-                    }
-                }
+/*
+ * lowerSSE2() is lowerScalar() sixteen characters at a time.
+ * 
+ */
 
-                // locking the mutex so that the file node can be inserted in the list
-            }
-        }
+void lowerSSE2(char *out, const char *data, size_t n)
+{
+    const __m128i lowerBit = _mm_set1_epi8(0x20);
+    size_t i = 0;
+
+    for (; i + 16 <= n; i += 16)
+    {
+        _mm_storeu_si128((__m128i *)(out + i), _mm_or_si128(_mm_loadu_si128((const __m128i *)(data + i)), lowerBit));
     }
 
-    closedir(dir);
+    lowerScalar(out + i, data + i, n - i);
+}
 
-    return 0;
+/*
+ * lowerAVX2() is lowerScalar() thirty-two characters at a time.
+ * 
+ */
+
+__attribute__((target("avx2"))) void lowerAVX2(char *out, const char *data, size_t n)
+{
+    const __m256i lowerBit = _mm256_set1_epi8(0x20);
+    size_t i = 0;
+
+    for (; i + 32 <= n; i += 32)
+    {
+        _mm256_storeu_si256((__m256i *)(out + i), _mm256_or_si256(_mm256_loadu_si256((const __m256i *)(data + i)), lowerBit));
+    }
+
+    lowerSSE2(out + i, data + i, n - i);
 }
 
+#endif
+
 /*
- * tokenize() finds the parameters that iterate() requires, and calls iterate().
+ * scanScalar() finds the end of the token starting at pos, which is the first whitespace
+ * after it or the end of the contents, using the class table.
  * 
- * The function uses the function findThread() to find the current directory
- * that the thread is working with. It will attempt to open the file found,
- * and if the file is not openable, it will return an error. Then, the function
- * will find the matching file node node that the thread is working with, so that
- * new word nodes can be added to the file node. It will then call iterate() to 
- * read the file.
+ * @param const char *data as the contents of the file
+ * @param size_t pos as the first character of the token
+ * @param size_t length as the number of bytes in the contents
+ * @param bool *clean to set to false if the token has a character that is not valid
  * 
- * @param struct args with the shared linked lists
+ * @return position right after the last character of the token
  * 
  */
 
-void *tokenize(struct args *argsParam)
+size_t scanScalar(const char *data, size_t pos, size_t length, bool *clean)
 {
-    // Finds the current directory and thread that the current thread is working with
-
-    struct fileNode *filePtr = findThread(argsParam);
+    while (pos < length)
+    {
+        unsigned char c = charClass[(unsigned char)data[pos]];
 
-    // Verifies that the current file can be opened
+        if (c & CLASS_SPACE)
+        {
+            break;
+        }
 
-    int fd = open(filePtr->fileName, O_RDONLY);
+        if (!(c & CLASS_WORD))
+        {
+            *clean = false;
+        }
 
-    if (fd == -1)
-    {
-        printf("Error: File [%s] is not accessible, returning\n", filePtr->fileName);
-        return 0;
+        pos++;
     }
 
-    // Iterates throught the contents of the file and adds word nodes to corresponding file node
+    return pos;
+}
 
-    iterate(filePtr, fd);
+/*
+ * lowerScalar() copies a token whose characters are all letters and dashes in lowercase.
+ * Setting the 0x20 bit lowercases an ASCII letter, and a dash already has it set.
+ * 
+ * @param char *out to copy the token to
+ * @param const char *data as the token
+ * @param size_t n as the number of characters
+ * 
+ */
 
-    return 0;
+void lowerScalar(char *out, const char *data, size_t n)
+{
+    for (size_t i = 0; i < n; i++)
+    {
+        out[i] = data[i] | 0x20;
+    }
 }
 
 /*
- * iterate() is a recursive function that goes through the current file by character.
- * The function only counts alphabetical characters and dashes (-) as valid characters.
+ * collectFiles() puts every file node that is not a folder into an array, in the
+ * order of the file linked list, so that files can be addressed by index.
  * 
- * THe function initially allocates a string that can store 15 characters. If the string
- * in the file is more than 15 characters, it reallocates space for another 15 characters.
- * If it encounters a whitespace, it stops reading from the file and inserts the new 
- * token into the corresponding file node's word linked list. If the file already contains
- * the new token, it will free the new token and increment the matched word node. If the file
- * does not contain the token, then the function will insert the new word node into the file's
- * word linked list alphabetically automatically. The function will recurse if it encounters a
- * whitespace, since there are more tokens to be read in the file.
+ * @param struct args with the file linked list
+ * @param int *numFiles to store the number of files in
  * 
- * @param struct fileNode as a pointer to the next fileNode
- * @param int fd as the file descriptor number
+ * @return array of file node pointers
  * 
  */
 
-void iterate(struct fileNode *filePtr, int fd)
+struct fileNode **collectFiles(struct args *argsParam, int *numFiles)
 {
-    // Allocates space in the memory for a new token
+    int count = 0;
+    struct fileNode *filePtr = argsParam->fileHead;
 
-    char *newTok = (char *)malloc(sizeof(char) * 15);
+    while (filePtr != NULL)
+    {
+        if (!filePtr->folder)
+        {
+            count++;
+        }
 
-    char c;
-    int bytes;
-    int i = 0;
-    int numRe = 1;
-    bool whitespace = false;
+        filePtr = filePtr->next;
+    }
 
-    // Reads the data in the current file
+    struct fileNode **files = (struct fileNode **)malloc(sizeof(struct fileNode *) * (count + 1));
+    count = 0;
+    filePtr = argsParam->fileHead;
 
-    while ((bytes = read(fd, &c, sizeof(c))) > 0)
+    while (filePtr != NULL)
     {
-        if (i > (15 * numRe) - 1)
+        if (!filePtr->folder)
         {
-            // If the length of the current token is greater than 15 characters, newTok allocates more memory
+            files[count++] = filePtr;
+        }
 
-            numRe++;
-            newTok = (char *)realloc(newTok, sizeof(char) * (i + 15));
+        filePtr = filePtr->next;
+    }
 
-            if (newTok == NULL)
-            {
-                printf("Error: Failed to realloc string, exiting\n");
-                exit(0);
-            }
-        }
+    *numFiles = count;
 
-        if (isspace(c))
-        {
-            // If a whitespace is found, the loop has reached the end of the word and breaks out of the loop
+    return files;
+}
 
-            whitespace = true;
-            break;
-        }
-        else if (isalpha(c) || c == '-')
+/*
+ * groupFiles() puts the files of an analysis into groups of identical contents, using the
+ * originals found by dedupFile(). Groups are numbered in the order of their first file,
+ * and each group is compared through its first file, which has the same words as the
+ * rest of the group. The files of group g are members[memberStart[g]] up to
+ * members[memberStart[g + 1]], in the order of the file array.
+ * 
+ * @param struct pairTask with the array of every file, to fill in the groups
+ * 
+ */
+
+void groupFiles(struct pairTask *task)
+{
+    int numGroups = 0;
+
+    for (int f = 0; f < task->numAllFiles; f++)
+    {
+        if (task->allFiles[f]->original == NULL)
         {
-            // Only alphabetical characters and dashes count as valid charaters
+            task->allFiles[f]->group = numGroups++;
+        }
+    }
 
-            newTok[i] = tolower(c);
-            i++;
+    task->memberStart = (int *)calloc(numGroups + 1, sizeof(int));
+    task->members = (int *)malloc(sizeof(int) * task->numAllFiles);
+
+    for (int f = 0; f < task->numAllFiles; f++)
+    {
+        if (task->allFiles[f]->original != NULL)
+        {
+            task->allFiles[f]->group = task->allFiles[f]->original->group;
         }
+
+        task->memberStart[task->allFiles[f]->group + 1]++;
     }
 
-    newTok[i] = '\0';
+    for (int g = 0; g < numGroups; g++)
+    {
+        task->memberStart[g + 1] += task->memberStart[g];
+    }
+
+    // Filling in the members in file order, using a copy of the starting positions as the next free slot
+
+    int *next = (int *)malloc(sizeof(int) * (numGroups + 1));
+    memcpy(next, task->memberStart, sizeof(int) * (numGroups + 1));
 
-    if (i == 0)
+    for (int f = 0; f < task->numAllFiles; f++)
     {
-        // If no data has been read, it frees the token malloced and nothing will happen
+        task->members[next[task->allFiles[f]->group]++] = f;
+    }
+
+    free(next);
 
-        free(newTok);
+    task->numFiles = numGroups;
+    task->files = (struct fileNode **)malloc(sizeof(struct fileNode *) * (numGroups + 1));
+
+    for (int g = 0; g < numGroups; g++)
+    {
+        task->files[g] = task->allFiles[task->members[task->memberStart[g]]];
     }
-    else
+}
+
+/*
+ * numCores() returns the number of online cores, which is how many worker threads
+ * the analysis uses.
+ * 
+ * @return number of cores, at least 1
+ * 
+ */
+
+long numCores(void)
+{
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+
+    return (cores < 1) ? 1 : cores;
+}
+
+/*
+ * parallelFor() calls body() on every chunk of the range [0, count) using one worker
+ * thread per core. Workers take the next chunk off a shared counter until the range is
+ * used up, so uneven chunks still balance out.
+ * 
+ * @param long count as the size of the range
+ * @param long chunk as the number of indexes handed out at once
+ * @param body() to call on each chunk with the shared context
+ * @param void *ctx as the shared context
+ * 
+ */
+
+void parallelFor(long count, long chunk, void (*body)(void *ctx, long start, long end), void *ctx)
+{
+    struct parallelLoop loop;
+    loop.count = count;
+    loop.chunk = chunk;
+    loop.next = 0;
+    loop.body = body;
+    loop.ctx = ctx;
+
+    if (pthread_mutex_init(&loop.lock, NULL) != 0)
+    {
+        printf("Error: Mutex initialization failed, exiting\n");
+        exit(0);
+    }
+
+    long numWorkers = numCores();
+
+    if (numWorkers > (count + chunk - 1) / chunk)
+    {
+        numWorkers = (count + chunk - 1) / chunk;
+    }
+
+    pthread_t *ids = (pthread_t *)malloc(sizeof(pthread_t) * (numWorkers + 1));
+
+    for (long w = 0; w < numWorkers; w++)
+    {
+        if (pthread_create(&ids[w], NULL, parallelWorker, &loop) != 0)
+        {
+            printf("Error: Creating thread unsuccessful, exiting\n");
+            exit(0);
+        }
+    }
+
+    for (long w = 0; w < numWorkers; w++)
     {
-        // Adds one to the file node total since a new token has been found
+        pthread_join(ids[w], NULL);
+    }
+
+    pthread_mutex_destroy(&loop.lock);
+    free(ids);
+}
 
-        filePtr->total++;
+/*
+ * parallelWorker() is the starting point of every thread created by parallelFor().
+ * 
+ * @param struct parallelLoop with the range and the shared counter
+ * 
+ */
 
-        struct wordNode *newWord = (struct wordNode *)malloc(sizeof(struct wordNode));
-        newWord->word = newTok;
-        newWord->occurrence = 1;
-        newWord->next = NULL;
+void *parallelWorker(void *param)
+{
+    struct parallelLoop *loop = (struct parallelLoop *)param;
 
-        // Determines if the new token already exists or adds a new word node in the correct place in the word linked list alphabetically
+    while (true)
+    {
+        pthread_mutex_lock(&loop->lock);
+        long start = loop->next;
+        loop->next += loop->chunk;
+        pthread_mutex_unlock(&loop->lock);
 
-        if (filePtr->wordHead == NULL)
+        if (start >= loop->count)
         {
-            filePtr->wordHead = newWord;
+            break;
         }
-        else
-        {
-            struct wordNode *wordPtr = filePtr->wordHead;
-            struct wordNode *prev = NULL;
-            bool exist = false;
-            bool less = false;
-
-            while (wordPtr != NULL)
-            {
-                if (strcmp(wordPtr->word, newTok) > 0)
-                {
-                    less = true;
-                    break;
-                }
-                else if (strcmp(wordPtr->word, newTok) == 0)
-                {
-                    free(newTok);
-                    free(newWord);
-                    wordPtr->occurrence++;
-                    exist = true;
-                    break;
-                }
-                else if (wordPtr->next == NULL)
-                {
-                    break;
-                }
 
-                prev = wordPtr;
-                wordPtr = wordPtr->next;
-            }
-
-            if (less)
-            {
-                newWord->next = wordPtr;
+        long end = (start + loop->chunk < loop->count) ? start + loop->chunk : loop->count;
 
-                if (prev == NULL)
-                {
-                    filePtr->wordHead = newWord;
-                }
-                else
-                {
-                    prev->next = newWord;
-                }
-            }
-            else if (!exist)
-            {
-                wordPtr->next = newWord;
-            }
-        }
+        loop->body(loop->ctx, start, end);
     }
 
-    // If a whitespace is found, the method recurses since there is more data to be read
-
-    if (whitespace)
-    {
-        iterate(filePtr, fd);
-    }
+    return 0;
 }
 
 /*
- * anal() analyzes all the file nodes, and calculates the Jensen-Shannon Distance
- * for each file.
+ * nearest() finds the K closest files to every file without comparing every pair.
  * 
- * The function utilizes two while loops to make sure that each node in the file
- * linked list is compared with each other. At each comparision, the function will
- * calculate the Kullbek-Leibler Divergences with each word node and get the
- * Jensen-Shannon Distance. Each value is stored in a mean node so that the program
- * can reference the values later.
+ * The function gives every file a MinHash signature of LSH_HASHES values, where each
+ * value is the smallest hash of the file's word ids under one hash function. Two files
+ * agree on a value with a probability equal to the overlap of their vocabularies. The
+ * signature is cut into LSH_BANDS bands of LSH_ROWS values, and files whose band hashes
+ * are equal for at least one band become candidate pairs. Only the candidate pairs are
+ * compared exactly with compare(), in parallel, and for every file the K candidates with
+ * the smallest Jensen-Shannon Distance are printed. Both passes are roughly linear in the
+ * number of files, unless a huge number of files are near copies of each other.
  * 
- * @param struct args with the file linked list
+ * @param struct args with the file linked list and the K to print
  * 
  */
 
-void anal(struct args *argsParam)
+void nearest(struct args *argsParam)
 {
-    struct fileNode *filePtr1 = argsParam->fileHead;
-    struct fileNode *filePtr2 = argsParam->fileHead;
+    struct lshTask task;
+    task.files = collectFiles(argsParam, &task.numFiles);
 
-    // Loops through all the file nodes in the file linked list
+    // Computing the signature of every file in parallel
 
-    while (filePtr1 != NULL)
-    {
-        // If the current file is a folder, it will skip it
+    task.signatures = (uint32_t *)malloc(sizeof(uint32_t) * LSH_HASHES * (task.numFiles + 1));
 
-        if (filePtr1->folder)
-        {
-            filePtr1 = filePtr1->next;
-            continue;
-        }
+    parallelFor(task.numFiles, 64, signatureBody, &task);
 
-        // Sets the second file pointer to filePtr1->next so that all the files will be compared with each other
+    // Hashing every band of every file and sorting each band so that equal hashes are adjacent
+    // Files without words are left out, since their signatures would all collide
 
-        filePtr2 = filePtr1->next;
+    struct bucketEntry *buckets = (struct bucketEntry *)malloc(sizeof(struct bucketEntry) * (task.numFiles + 1));
+    uint64_t *candidates = NULL;
+    long numCandidates = 0;
+    long capacity = 0;
 
-        while (filePtr2 != NULL)
-        {
-            // If the current file is a folder, it will skip it
+    for (int band = 0; band < LSH_BANDS; band++)
+    {
+        int numBuckets = 0;
 
-            if (filePtr2->folder)
+        for (int i = 0; i < task.numFiles; i++)
+        {
+            if (task.files[i]->numWords == 0)
             {
-                filePtr2 = filePtr2->next;
                 continue;
             }
 
-            // Initializing a new mean node
+            uint64_t hash = band;
+
+            for (int row = 0; row < LSH_ROWS; row++)
+            {
+                hash = mix64(hash ^ task.signatures[(long)i * LSH_HASHES + band * LSH_ROWS + row]);
+            }
+
+            buckets[numBuckets].hash = hash;
+            buckets[numBuckets].file = i;
+            numBuckets++;
+        }
+
+        qsort(buckets, numBuckets, sizeof(struct bucketEntry), compareBuckets);
 
-            struct meanNode *newMean = (struct meanNode *)malloc(sizeof(struct meanNode));
-            newMean->fileName1 = filePtr1->fileName;
-            newMean->fileName2 = filePtr2->fileName;
-            newMean->total = 0;
-            newMean->KLD1 = 0;
-            newMean->KLD2 = 0;
-            newMean->JSD = 0;
-            newMean->next = NULL;
+        // Pairing the files of every group of equal hashes
 
-            struct wordNode *wordPtr1 = filePtr1->wordHead;
-            struct wordNode *wordPtr2 = filePtr2->wordHead;
+        int start = 0;
 
-            // Loops through all the words between both files being compared and calculates the necessary data
+        while (start < numBuckets)
+        {
+            int end = start + 1;
 
-            while (wordPtr1 != NULL || wordPtr2 != NULL)
+            while (end < numBuckets && buckets[end].hash == buckets[start].hash)
             {
-                // Calculating the data for the Jensen-Shannon Distance between both files
+                end++;
+            }
 
-                if (wordPtr1 != NULL && wordPtr2 != NULL)
+            for (int i = start; i < end; i++)
+            {
+                for (int j = i + 1; j < end && j <= i + LSH_MAX_BUCKET; j++)
                 {
-                    if (strcmp(wordPtr1->word, wordPtr2->word) == 0)
+                    if (numCandidates == capacity)
                     {
-                        float meanProb = ((wordPtr1->occurrence / filePtr1->total) + (wordPtr2->occurrence / filePtr2->total)) / 2;
-
-                        float KLD1 = (wordPtr1->occurrence / filePtr1->total) * log10((wordPtr1->occurrence / filePtr1->total) / meanProb);
+                        capacity = (capacity == 0) ? 1024 : capacity * 2;
+                        candidates = (uint64_t *)realloc(candidates, sizeof(uint64_t) * capacity);
 
-                        float KLD2 = (wordPtr2->occurrence / filePtr2->total) * log10((wordPtr2->occurrence / filePtr2->total) / meanProb);
+                        if (candidates == NULL)
+                        {
+                            printf("Error: Failed to realloc candidates, exiting\n");
+                            exit(0);
+                        }
+                    }
 
-                        newMean->KLD1 += KLD1;
-                        newMean->KLD2 += KLD2;
+                    // Candidates are stored as (smaller index, larger index) so duplicates sort together
 
-                        wordPtr1 = wordPtr1->next;
-                        wordPtr2 = wordPtr2->next;
+                    uint64_t file1 = buckets[i].file;
+                    uint64_t file2 = buckets[j].file;
 
-                        newMean->total++;
-                    }
-                    else if (strcmp(wordPtr1->word, wordPtr2->word) > 0)
-                    {
-                        float meanProb = ((0) + (wordPtr2->occurrence / filePtr2->total)) / 2;
+                    candidates[numCandidates++] = (file1 < file2) ? (file1 << 32 | file2) : (file2 << 32 | file1);
+                }
+            }
 
-                        float KLD2 = (wordPtr2->occurrence / filePtr2->total) * log10((wordPtr2->occurrence / filePtr2->total) / meanProb);
+            start = end;
+        }
+    }
 
-                        newMean->KLD2 += KLD2;
+    free(buckets);
+    free(task.signatures);
 
-                        wordPtr2 = wordPtr2->next;
+    // Removing the pairs that collided in more than one band
 
-                        newMean->total++;
-                    }
-                    else if (strcmp(wordPtr1->word, wordPtr2->word) < 0)
-                    {
-                        float meanProb = ((wordPtr1->occurrence / filePtr1->total) + (0)) / 2;
+    qsort(candidates, numCandidates, sizeof(uint64_t), compareCandidates);
 
-                        float KLD1 = (wordPtr1->occurrence / filePtr1->total) * log10((wordPtr1->occurrence / filePtr1->total) / meanProb);
+    long numUnique = 0;
 
-                        newMean->KLD1 += KLD1;
+    for (long c = 0; c < numCandidates; c++)
+    {
+        if (numUnique == 0 || candidates[c] != candidates[numUnique - 1])
+        {
+            candidates[numUnique++] = candidates[c];
+        }
+    }
 
-                        wordPtr1 = wordPtr1->next;
+    // Comparing every candidate pair exactly, in parallel
 
-                        newMean->total++;
-                    }
-                }
-                else if (wordPtr1 == NULL)
-                {
-                    float meanProb = ((0) + (wordPtr2->occurrence / filePtr2->total)) / 2;
+    task.candidates = candidates;
+    task.results = (struct meanNode *)malloc(sizeof(struct meanNode) * (numUnique + 1));
 
-                    float KLD2 = (wordPtr2->occurrence / filePtr2->total) * log10((wordPtr2->occurrence / filePtr2->total) / meanProb);
+    double start = seconds(CLOCK_MONOTONIC);
 
-                    newMean->KLD2 += KLD2;
+    parallelFor(numUnique, 256, candidateBody, &task);
 
-                    wordPtr2 = wordPtr2->next;
+    if (argsParam->stats != NULL)
+    {
+        argsParam->stats->pairTime = seconds(CLOCK_MONOTONIC) - start;
+        argsParam->stats->pairsComputed = numUnique;
+    }
 
-                    newMean->total++;
-                }
-                else if (wordPtr2 == NULL)
-                {
-                    float meanProb = ((wordPtr1->occurrence / filePtr1->total) + (0)) / 2;
+    // Listing every pair once for each of its files and sorting by file, then by distance
 
-                    float KLD1 = (wordPtr1->occurrence / filePtr1->total) * log10((wordPtr1->occurrence / filePtr1->total) / meanProb);
+    struct neighbour *neighbours = (struct neighbour *)malloc(sizeof(struct neighbour) * (2 * numUnique + 1));
 
-                    newMean->KLD1 += KLD1;
+    for (long c = 0; c < numUnique; c++)
+    {
+        struct meanNode *mean = &task.results[c];
+
+        neighbours[2 * c].file = mean->index1;
+        neighbours[2 * c].other = mean->index2;
+        neighbours[2 * c].JSD = mean->JSD;
+        neighbours[2 * c + 1].file = mean->index2;
+        neighbours[2 * c + 1].other = mean->index1;
+        neighbours[2 * c + 1].JSD = mean->JSD;
+    }
 
-                    wordPtr1 = wordPtr1->next;
+    qsort(neighbours, 2 * numUnique, sizeof(struct neighbour), compareNeighbours);
 
-                    newMean->total++;
-                }
-            }
+    // Printing the first K neighbours of every file
 
-            newMean->JSD = (newMean->KLD1 + newMean->KLD2) / 2;
+    long n = 0;
 
-            // Inserts the new mean node in the mena linked list in decreasing order
+    while (n < 2 * numUnique)
+    {
+        int file = neighbours[n].file;
 
-            if (argsParam->meanHead == NULL)
+        for (int k = 0; n < 2 * numUnique && neighbours[n].file == file; n++, k++)
+        {
+            if (k < argsParam->topK)
             {
-                argsParam->meanHead = newMean;
+                printMean(neighbours[n].JSD, task.files[file]->fileName, task.files[neighbours[n].other]->fileName);
             }
-            else
-            {
-                struct meanNode *tempMean = argsParam->meanHead;
-                struct meanNode *prevMean = NULL;
+        }
+    }
 
-                while (tempMean != NULL)
-                {
-                    if (tempMean->total <= newMean->total)
-                    {
-                        if (prevMean == NULL)
-                        {
-                            newMean->next = tempMean;
-                            argsParam->meanHead = newMean;
-                        }
-                        else
-                        {
-                            prevMean->next = newMean;
-                            newMean->next = tempMean;
-                        }
+    free(neighbours);
+    free(task.results);
+    free(candidates);
+    free(task.files);
+}
 
-                        break;
-                    }
+/*
+ * signatureBody() computes the MinHash signatures of the files in [start, end).
+ * 
+ * Hash function h of the signature maps a word id to mix64(id * LSH_HASHES + h), and
+ * the signature keeps the smallest value of each function over all the file's words.
+ * 
+ * @param struct lshTask with the files and the signature array
+ * @param long start and end as the range of files
+ * 
+ */
 
-                    prevMean = tempMean;
-                    tempMean = tempMean->next;
-                }
+void signatureBody(void *ctx, long start, long end)
+{
+    struct lshTask *task = (struct lshTask *)ctx;
+
+    for (long i = start; i < end; i++)
+    {
+        uint32_t *signature = task->signatures + i * LSH_HASHES;
+        struct fileNode *filePtr = task->files[i];
+
+        for (int h = 0; h < LSH_HASHES; h++)
+        {
+            signature[h] = UINT32_MAX;
+        }
+
+        for (int w = 0; w < filePtr->numWords; w++)
+        {
+            uint64_t base = (uint64_t)filePtr->ids[w] * LSH_HASHES;
+
+            for (int h = 0; h < LSH_HASHES; h++)
+            {
+                uint32_t value = (uint32_t)(mix64(base + h) >> 32);
 
-                if (tempMean == NULL)
+                if (value < signature[h])
                 {
-                    prevMean->next = newMean;
+                    signature[h] = value;
                 }
             }
-
-            filePtr2 = filePtr2->next;
         }
-
-        filePtr1 = filePtr1->next;
     }
 }
 
 /*
- * findThread() iterates through all the thread nodes and returns the
- * matching current thread.
+ * candidateBody() compares the candidate pairs in [start, end) exactly.
  * 
- * With the way that the structs are implemented, the current directory
- * that the current thread is working with is unknown. To find the current
- * directory, the directory name is stored in the file node. Finding
- * the matching file node will find the current directory that the 
- * current thread is working with.
+ * @param struct lshTask with the files, the candidate pairs and the result array
+ * @param long start and end as the range of candidate pairs
  * 
- * @param struct args with the file linked list
+ */
+
+void candidateBody(void *ctx, long start, long end)
+{
+    struct lshTask *task = (struct lshTask *)ctx;
+
+    for (long c = start; c < end; c++)
+    {
+        int index1 = (int)(task->candidates[c] >> 32);
+        int index2 = (int)(task->candidates[c] & 0xFFFFFFFF);
+
+        task->results[c] = compare(task->files[index1], task->files[index2], index1, index2);
+    }
+}
+
+/*
+ * mix64() is the splitmix64 finalizer, a fast hash that spreads every input bit over
+ * the whole 64-bit output.
  * 
- * @return matching file node
+ * @param uint64_t x to hash
+ * 
+ * @return hashed value
  * 
  */
 
-struct fileNode *findThread(struct args *argsParam)
+uint64_t mix64(uint64_t x)
 {
-    struct fileNode *filePtr = argsParam->fileHead;
+    x += 0x9E3779B97F4A7C15ULL;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
 
-    pthread_t tid = pthread_self();
+    return x ^ (x >> 31);
+}
 
-    bool broken = false;
+/*
+ * compareBuckets(), compareCandidates() and compareNeighbours() are the qsort()
+ * comparators used by nearest().
+ * 
+ */
 
-    // Loops through all the file nodes to find the current directory that the thread is working with
+int compareBuckets(const void *a, const void *b)
+{
+    const struct bucketEntry *bucket1 = (const struct bucketEntry *)a;
+    const struct bucketEntry *bucket2 = (const struct bucketEntry *)b;
 
-    while (filePtr != NULL)
+    if (bucket1->hash != bucket2->hash)
     {
-        if (pthread_equal(filePtr->id, tid))
-        {
-            broken = true;
-            break;
-        }
+        return (bucket1->hash < bucket2->hash) ? -1 : 1;
+    }
 
-        filePtr = filePtr->next;
+    return bucket1->file - bucket2->file;
+}
+
+int compareCandidates(const void *a, const void *b)
+{
+    uint64_t candidate1 = *(const uint64_t *)a;
+    uint64_t candidate2 = *(const uint64_t *)b;
+
+    return (candidate1 > candidate2) - (candidate1 < candidate2);
+}
+
+int compareNeighbours(const void *a, const void *b)
+{
+    const struct neighbour *neighbour1 = (const struct neighbour *)a;
+    const struct neighbour *neighbour2 = (const struct neighbour *)b;
+
+    if (neighbour1->file != neighbour2->file)
+    {
+        return neighbour1->file - neighbour2->file;
     }
 
-    if (argsParam->fileHead != NULL && !broken)
+    if (neighbour1->JSD != neighbour2->JSD)
     {
-        printf("Error: Thread not found, exiting\n");
-        exit(0);
+        return (neighbour1->JSD < neighbour2->JSD) ? -1 : 1;
     }
 
-    return filePtr;
+    return neighbour1->other - neighbour2->other;
 }
 
 /*
@@ -797,8 +7444,9 @@ void split(struct fileNode *source, struct fileNode **front, struct fileNode **b
 /*
  * printing() prints the Jensen-Shannon Distance calculations for each file compared.
  * 
- * The function loops through the mean linked list and prints the calculated 
+ * The function loops through the mean array and prints the calculated 
  * Jensen-Shannon Distance for each file comparison. It color codes the results accordingly.
+ * Under --mem-limit, there is no mean array, and mergeRuns() prints the spilled runs.
  * 
  * The commented out code prints out each file that the program detects, and prints out
  * each word in the file.
@@ -833,42 +7481,209 @@ void printing(struct args *argsParam)
     //     filePtr = filePtr->next;
     // }
 
-    struct meanNode *meanPtr = argsParam->meanHead;
+    // Under --mem-limit, the results are merged from the spill file instead
+
+    if (argsParam->runs != NULL)
+    {
+        mergeRuns(argsParam);
+        return;
+    }
 
     // Loops through all the mean nodes and prints out the Jensen-Shannon Distance for each comparison
 
-    while (meanPtr != NULL)
+    for (long m = 0; m < argsParam->numMeans; m++)
     {
-        if (meanPtr->JSD >= 0 && meanPtr->JSD <= 0.1)
-        {
-            printf("\033[0;31m");
-        }
-        else if (meanPtr->JSD > 0.1 && meanPtr->JSD <= 0.15)
-        {
-            printf("\033[0;33m");
-        }
-        else if (meanPtr->JSD > 0.15 && meanPtr->JSD <= 0.2)
-        {
-            printf("\033[0;32m");
-        }
-        else if (meanPtr->JSD > 0.2 && meanPtr->JSD <= 0.25)
+        printMean(argsParam->means[m].JSD, argsParam->means[m].fileName1, argsParam->means[m].fileName2);
+    }
+}
+
+/*
+ * seconds() reads a clock in seconds.
+ * 
+ * @param clockid_t clock to read, like CLOCK_MONOTONIC or CLOCK_THREAD_CPUTIME_ID
+ * 
+ * @return time in seconds
+ * 
+ */
+
+double seconds(clockid_t clock)
+{
+    struct timespec now;
+
+    clock_gettime(clock, &now);
+
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+/*
+ * markPhase() ends the current phase of the run for --stats, recording the wall time,
+ * the user and system CPU time of the whole process since the last mark, and the peak
+ * RSS so far. A NULL name only starts the clock. Without --stats, stats is NULL and
+ * nothing happens, so the phases can be marked unconditionally.
+ * 
+ * @param struct runStats to record the phase in, or NULL
+ * @param const char *name of the phase that just ended
+ * 
+ */
+
+void markPhase(struct runStats *stats, const char *name)
+{
+    if (stats == NULL)
+    {
+        return;
+    }
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+
+    double wall = seconds(CLOCK_MONOTONIC);
+    double user = usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6;
+    double sys = usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+
+    if (name != NULL && stats->numPhases < STATS_PHASES)
+    {
+        int p = stats->numPhases++;
+
+        stats->phase[p] = name;
+        stats->wall[p] = wall - stats->lastWall;
+        stats->user[p] = user - stats->lastUser;
+        stats->sys[p] = sys - stats->lastSys;
+        stats->peakRSS[p] = usage.ru_maxrss;
+    }
+
+    stats->lastWall = wall;
+    stats->lastUser = user;
+    stats->lastSys = sys;
+}
+
+/*
+ * tallyFiles() adds up the counters each reading thread left in its own file node, so
+ * the threads never share a counter while they run.
+ * 
+ * @param struct args with the file linked list and the stats
+ * 
+ */
+
+void tallyFiles(struct args *argsParam)
+{
+    struct runStats *stats = argsParam->stats;
+
+    if (stats == NULL)
+    {
+        return;
+    }
+
+    struct fileNode *filePtr = argsParam->fileHead;
+
+    while (filePtr != NULL)
+    {
+        if (filePtr->folder)
         {
-            printf("\033[0;36m");
+            stats->directories++;
+            stats->traversalCpu += filePtr->cpuTime;
         }
-        else if (meanPtr->JSD > 0.25 && meanPtr->JSD <= 0.3)
+        else
         {
-            printf("\033[0;34m");
+            stats->files++;
+            stats->cachedFiles += filePtr->cached;
+            stats->duplicateFiles += (filePtr->original != NULL);
+            stats->bytes += filePtr->statted ? filePtr->size : 0;
+            stats->tokens += filePtr->total;
         }
-        else
+
+        filePtr = filePtr->next;
+    }
+}
+
+/*
+ * printStats() prints what --stats collected to stderr, as comma separated lines that
+ * are easy to pick out of the output and parse:
+ * 
+ *     stats,phase,<name>,<wall s>,<user s>,<system s>,<peak RSS KB>
+ *     stats,<counter>,<value>
+ * 
+ * The phases are printed in the order they ran. The CPU times of a phase cover every
+ * thread of the process, while traversal_cpu_s and tokenize_cpu_s split the reading
+ * phase between the directory threads and the file threads. Rates are taken over the
+ * wall time of the phase that did the work.
+ * 
+ * @param struct runStats to print
+ * 
+ */
+
+void printStats(struct runStats *stats)
+{
+    double readTime = 0;
+
+    for (int p = 0; p < stats->numPhases; p++)
+    {
+        fprintf(stderr, "stats,phase,%s,%.6f,%.6f,%.6f,%ld\n", stats->phase[p], stats->wall[p], stats->user[p], stats->sys[p], stats->peakRSS[p]);
+
+        if (strcmp(stats->phase[p], "read") == 0 || strcmp(stats->phase[p], "load") == 0)
         {
-            printf("\033[0m");
+            readTime = stats->wall[p];
         }
+    }
 
-        printf("%f \"%s\" and \"%s\"\n", meanPtr->JSD, meanPtr->fileName1, meanPtr->fileName2);
-        printf("\033[0m");
+    long pairs = stats->pairsComputed + stats->pairsStored;
+
+    fprintf(stderr, "stats,files,%ld\n", stats->files);
+    fprintf(stderr, "stats,directories,%ld\n", stats->directories);
+    fprintf(stderr, "stats,cached_files,%ld\n", stats->cachedFiles);
+    fprintf(stderr, "stats,duplicate_files,%ld\n", stats->duplicateFiles);
+    fprintf(stderr, "stats,bytes,%llu\n", (unsigned long long)stats->bytes);
+    fprintf(stderr, "stats,tokens,%ld\n", stats->tokens);
+    fprintf(stderr, "stats,tokens_per_s,%.0f\n", (readTime > 0) ? stats->tokens / readTime : 0);
+    fprintf(stderr, "stats,unique_words,%ld\n", stats->uniqueWords);
+    fprintf(stderr, "stats,traversal_cpu_s,%.6f\n", stats->traversalCpu);
+    fprintf(stderr, "stats,tokenize_cpu_s,%.6f\n", stats->tokenizeCpu);
+    fprintf(stderr, "stats,analysis_workers,%ld\n", stats->workers);
+    fprintf(stderr, "stats,pairs,%ld\n", pairs);
+    fprintf(stderr, "stats,pairs_computed,%ld\n", stats->pairsComputed);
+    fprintf(stderr, "stats,pairs_stored,%ld\n", stats->pairsStored);
+    fprintf(stderr, "stats,shared_terms,%ld\n", stats->sharedTerms);
+    fprintf(stderr, "stats,pairs_per_s,%.0f\n", (stats->pairTime > 0) ? pairs / stats->pairTime : 0);
+    fprintf(stderr, "stats,peak_rss_kb,%ld\n", (stats->numPhases > 0) ? stats->peakRSS[stats->numPhases - 1] : 0);
+}
+
+/*
+ * printMean() prints one Jensen-Shannon Distance and the two files it belongs to,
+ * color coded from red (most similar) to blue, and uncolored above 0.3.
+ * 
+ * @param float JSD as the distance to print
+ * @param char *fileName1 and *fileName2 as the files compared
+ * 
+ */
 
-        meanPtr = meanPtr->next;
+void printMean(float JSD, char *fileName1, char *fileName2)
+{
+    if (JSD >= 0 && JSD <= 0.1)
+    {
+        printf("\033[0;31m");
+    }
+    else if (JSD > 0.1 && JSD <= 0.15)
+    {
+        printf("\033[0;33m");
+    }
+    else if (JSD > 0.15 && JSD <= 0.2)
+    {
+        printf("\033[0;32m");
+    }
+    else if (JSD > 0.2 && JSD <= 0.25)
+    {
+        printf("\033[0;36m");
+    }
+    else if (JSD > 0.25 && JSD <= 0.3)
+    {
+        printf("\033[0;34m");
+    }
+    else
+    {
+        printf("\033[0m");
     }
+
+    printf("%f \"%s\" and \"%s\"\n", JSD, fileName1, fileName2);
+    printf("\033[0m");
 }
 
 /*
@@ -888,20 +7703,7 @@ void freeing(struct args *argsParam)
 
     while (filePtr != NULL)
     {
-        if (filePtr->wordHead != NULL)
-        {
-            struct wordNode *wordPtr = filePtr->wordHead;
-            struct wordNode *wordTemp = filePtr->wordHead;
-
-            while (wordPtr != NULL)
-            {
-                free(wordPtr->word);
-                wordTemp = wordPtr;
-                wordPtr = wordPtr->next;
-                free(wordTemp);
-            }
-        }
-
+        free(filePtr->words);
         free(filePtr->fileName);
 
         fileTemp = filePtr;
@@ -910,15 +7712,33 @@ void freeing(struct args *argsParam)
         free(fileTemp);
     }
 
-    struct meanNode *meanPtr = argsParam->meanHead;
-    struct meanNode *meanTemp = argsParam->meanHead;
+    if (argsParam->cache != NULL)
+    {
+        freeCache(argsParam->cache);
+    }
+
+    if (argsParam->store != NULL)
+    {
+        freeStore(argsParam->store);
+    }
 
-    while (meanPtr != NULL)
+    if (argsParam->snapshot != NULL)
     {
-        meanTemp = meanPtr;
-        meanPtr = meanPtr->next;
+        munmap(argsParam->snapshot, argsParam->snapshotLength);
+    }
 
-        free(meanTemp);
+    free(argsParam->means);
+    free(argsParam->vocab);
+    free(argsParam->vocabText);
+    spillFree(argsParam, argsParam->wordIds, sizeof(int) * argsParam->numEntries);
+    spillFree(argsParam, argsParam->wordCounts, sizeof(float) * argsParam->numEntries);
+
+    if (argsParam->runs != NULL)
+    {
+        close(argsParam->runs->fd);
+        free(argsParam->runs->runStart);
+        free(argsParam->runs->files);
+        free(argsParam->runs);
     }
 
     free(argsParam);
@@ -0,0 +1,687 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+#include <math.h>
+
+// Default size of the synthetic corpus, each of which can be changed with an option
+
+#define DEFAULT_FILES 200
+#define DEFAULT_MIN_WORDS 100
+#define DEFAULT_MAX_WORDS 2000
+#define DEFAULT_VOCAB 20000
+#define DEFAULT_ZIPF 1.1
+#define DEFAULT_DEPTH 3
+#define DEFAULT_FANOUT 4
+#define DEFAULT_SIMILAR 0.1
+#define DEFAULT_RUNS 3
+
+// Length limits of the synthetic words
+
+#define MIN_WORD_LENGTH 2
+#define MAX_WORD_LENGTH 12
+
+struct corpus
+{
+    char *dir;
+    int numFiles;
+    int minWords;
+    int maxWords;
+    int vocabSize;
+    double zipf;
+    int depth;
+    int fanout;
+    double similar;
+    uint64_t seed;
+    char **words;
+    double *cdf;
+    long totalWords;
+    long totalBytes;
+};
+
+struct measurement
+{
+    double wall;
+    double user;
+    double sys;
+    long peakRSS;
+    int status;
+};
+
+// Initializing functions first for better readablity
+
+uint64_t nextRandom(uint64_t *state);
+double uniform(uint64_t *state);
+void makeVocabulary(struct corpus *corpus, uint64_t *state);
+int zipfWord(struct corpus *corpus, uint64_t *state);
+void makeDirectories(struct corpus *corpus, char *path, int level);
+void makeCorpus(struct corpus *corpus);
+struct measurement run(char *const argv[], const char *errorPath);
+void report(struct corpus *corpus, const char *phase, int runIndex, struct measurement *result);
+void reportStats(struct corpus *corpus, int runIndex, struct measurement *result, const char *statsPath);
+void freeCorpus(struct corpus *corpus);
+int main(int argc, char *argv[]);
+
+/*
+ * main() generates a synthetic corpus and times the detector on it.
+ * 
+ * The corpus is written under the given directory, which must not exist yet (a fresh
+ * temporary directory by default): numFiles files spread over a tree of directories fanout wide and depth deep,
+ * with lengths drawn log-uniformly between the minimum and maximum number of words, and
+ * words drawn from a Zipfian distribution over a vocabulary of random words. A fraction
+ * of the files (--similar) are copies of an earlier file with some of their words
+ * replaced, so that there are close pairs to find.
+ * 
+ * Each phase is run separately, once per run, in its own process, so that its time and
+ * peak memory can be measured on their own:
+ * 
+ *     ingest    reading, tokenizing and the vocabulary, through --snapshot
+ *     analysis  comparing every pair from that snapshot, through --load, printing nothing
+ *     full      the whole detector on the directory with its report sent to /dev/null
+ * 
+ * Every run is printed as one CSV line on stdout, with the wall time, user and system
+ * CPU time and peak RSS. The full run is also made with --stats, and every phase the
+ * detector reports (read, sort, vocabulary, analysis, output, ...) gets its own line as
+ * full/<phase>, with the peak RSS reached by the end of that phase.
+ * 
+ * Usage: ./benchmark [--files N] [--min-words N] [--max-words N] [--vocab N] [--zipf S]
+ *                    [--depth N] [--fanout N] [--similar P] [--seed N] [--runs N]
+ *                    [--detector PATH] [--dir PATH] [--keep]
+ * 
+ * @param int argc and char *argv[] as terminal inputs
+ * 
+ */
+
+int main(int argc, char *argv[])
+{
+    struct corpus corpus;
+    corpus.dir = NULL;
+    corpus.numFiles = DEFAULT_FILES;
+    corpus.minWords = DEFAULT_MIN_WORDS;
+    corpus.maxWords = DEFAULT_MAX_WORDS;
+    corpus.vocabSize = DEFAULT_VOCAB;
+    corpus.zipf = DEFAULT_ZIPF;
+    corpus.depth = DEFAULT_DEPTH;
+    corpus.fanout = DEFAULT_FANOUT;
+    corpus.similar = DEFAULT_SIMILAR;
+    corpus.seed = 1;
+    corpus.words = NULL;
+    corpus.cdf = NULL;
+    corpus.totalWords = 0;
+    corpus.totalBytes = 0;
+
+    char *detector = "./detector";
+    int runs = DEFAULT_RUNS;
+    bool keep = false;
+
+    // Reading the options
+
+    for (int i = 1; i < argc; i++)
+    {
+        bool hasValue = (i + 1 < argc);
+
+        if (strcmp(argv[i], "--files") == 0 && hasValue)
+        {
+            corpus.numFiles = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--min-words") == 0 && hasValue)
+        {
+            corpus.minWords = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--max-words") == 0 && hasValue)
+        {
+            corpus.maxWords = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--vocab") == 0 && hasValue)
+        {
+            corpus.vocabSize = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--zipf") == 0 && hasValue)
+        {
+            corpus.zipf = atof(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--depth") == 0 && hasValue)
+        {
+            corpus.depth = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--fanout") == 0 && hasValue)
+        {
+            corpus.fanout = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--similar") == 0 && hasValue)
+        {
+            corpus.similar = atof(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--seed") == 0 && hasValue)
+        {
+            corpus.seed = strtoull(argv[++i], NULL, 10);
+        }
+        else if (strcmp(argv[i], "--runs") == 0 && hasValue)
+        {
+            runs = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--detector") == 0 && hasValue)
+        {
+            detector = argv[++i];
+        }
+        else if (strcmp(argv[i], "--dir") == 0 && hasValue)
+        {
+            corpus.dir = strdup(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--keep") == 0)
+        {
+            keep = true;
+        }
+        else
+        {
+            printf("Error: Unknown option [%s], exiting\n", argv[i]);
+            exit(0);
+        }
+    }
+
+    // Verifying that the corpus makes sense
+
+    if (corpus.numFiles < 1 || corpus.minWords < 1 || corpus.maxWords < corpus.minWords || corpus.vocabSize < 1 || corpus.zipf <= 0 || corpus.depth < 0 || corpus.fanout < 1 || corpus.similar < 0 || corpus.similar > 1 || runs < 1)
+    {
+        printf("Error: Invalid corpus options, exiting\n");
+        exit(0);
+    }
+
+    if (access(detector, X_OK) != 0)
+    {
+        printf("Error: Detector [%s] cannot be run, exiting\n", detector);
+        exit(0);
+    }
+
+    if (corpus.dir == NULL)
+    {
+        char temp[] = "/tmp/detector-bench-XXXXXX";
+
+        if (mkdtemp(temp) == NULL)
+        {
+            printf("Error: Temporary directory cannot be created, exiting\n");
+            exit(0);
+        }
+
+        corpus.dir = strdup(temp);
+    }
+    else if (mkdir(corpus.dir, 0755) != 0)
+    {
+        // An existing directory is refused, since the corpus is removed with everything in it at the end
+
+        if (errno == EEXIST)
+        {
+            printf("Error: [%s] already exists, please pass a new directory, exiting\n", corpus.dir);
+        }
+        else
+        {
+            printf("Error: [%s] directory cannot be created, exiting\n", corpus.dir);
+        }
+
+        exit(0);
+    }
+
+    // Writing the corpus
+
+    makeCorpus(&corpus);
+
+    char *snapshot = (char *)malloc(sizeof(char) * (strlen(corpus.dir) + 16));
+    strcpy(snapshot, corpus.dir);
+    strcat(snapshot, ".snapshot");
+
+    char *statsPath = (char *)malloc(sizeof(char) * (strlen(corpus.dir) + 16));
+    strcpy(statsPath, corpus.dir);
+    strcat(statsPath, ".stats");
+
+    // Timing every phase, one process per run
+
+    printf("files,words,bytes,phase,run,wall_s,user_s,sys_s,peak_rss_kb,status\n");
+
+    for (int r = 0; r < runs; r++)
+    {
+        char *ingest[] = {detector, "--snapshot", snapshot, corpus.dir, NULL};
+        char *analysis[] = {detector, "--threshold", "0", "--load", snapshot, NULL};
+        char *full[] = {detector, "--stats", corpus.dir, NULL};
+
+        struct measurement result = run(ingest, NULL);
+        report(&corpus, "ingest", r, &result);
+
+        result = run(analysis, NULL);
+        report(&corpus, "analysis", r, &result);
+
+        result = run(full, statsPath);
+        report(&corpus, "full", r, &result);
+        reportStats(&corpus, r, &result, statsPath);
+    }
+
+    // Removing everything that was written unless it should be kept
+
+    unlink(snapshot);
+    unlink(statsPath);
+
+    if (!keep)
+    {
+        char *argvRemove[] = {"rm", "-rf", corpus.dir, NULL};
+        run(argvRemove, NULL);
+    }
+    else
+    {
+        fprintf(stderr, "Corpus kept in [%s]\n", corpus.dir);
+    }
+
+    free(snapshot);
+    free(statsPath);
+    freeCorpus(&corpus);
+
+    return 0;
+}
+
+/*
+ * nextRandom() is splitmix64, which is fast and good enough for a synthetic corpus, and
+ * makes the corpus depend on nothing but the seed.
+ * 
+ * @param uint64_t *state as the generator state
+ * 
+ * @return next 64 random bits
+ * 
+ */
+
+uint64_t nextRandom(uint64_t *state)
+{
+    uint64_t x = (*state += 0x9e3779b97f4a7c15ULL);
+
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+
+    return x ^ (x >> 31);
+}
+
+/*
+ * uniform() returns a random number in [0, 1).
+ * 
+ * @param uint64_t *state as the generator state
+ * 
+ * @return random double
+ * 
+ */
+
+double uniform(uint64_t *state)
+{
+    return (nextRandom(state) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/*
+ * makeVocabulary() makes vocabSize random lowercase words and the cumulative Zipfian
+ * distribution over them, where the word of rank k has a weight of 1 / k^zipf.
+ * 
+ * @param struct corpus with the vocabulary size and exponent
+ * @param uint64_t *state as the generator state
+ * 
+ */
+
+void makeVocabulary(struct corpus *corpus, uint64_t *state)
+{
+    corpus->words = (char **)malloc(sizeof(char *) * corpus->vocabSize);
+    corpus->cdf = (double *)malloc(sizeof(double) * corpus->vocabSize);
+
+    double sum = 0;
+
+    for (int w = 0; w < corpus->vocabSize; w++)
+    {
+        // The hundred most frequent words are short, like in real text
+
+        int maxLength = (w < 100) ? 6 : MAX_WORD_LENGTH;
+        int length = MIN_WORD_LENGTH + nextRandom(state) % (maxLength - MIN_WORD_LENGTH + 1);
+
+        corpus->words[w] = (char *)malloc(sizeof(char) * (length + 1));
+
+        for (int c = 0; c < length; c++)
+        {
+            corpus->words[w][c] = 'a' + nextRandom(state) % 26;
+        }
+
+        corpus->words[w][length] = '\0';
+
+        sum += 1.0 / pow(w + 1, corpus->zipf);
+        corpus->cdf[w] = sum;
+    }
+
+    for (int w = 0; w < corpus->vocabSize; w++)
+    {
+        corpus->cdf[w] /= sum;
+    }
+}
+
+/*
+ * zipfWord() draws the rank of a word by binary searching the cumulative distribution.
+ * 
+ * @param struct corpus with the distribution
+ * @param uint64_t *state as the generator state
+ * 
+ * @return index of the word in the vocabulary
+ * 
+ */
+
+int zipfWord(struct corpus *corpus, uint64_t *state)
+{
+    double u = uniform(state);
+    int lo = 0;
+    int hi = corpus->vocabSize - 1;
+
+    while (lo < hi)
+    {
+        int mid = lo + (hi - lo) / 2;
+
+        if (corpus->cdf[mid] < u)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+
+    return lo;
+}
+
+/*
+ * makeDirectories() creates the full directory tree below path, fanout directories
+ * named d0, d1, ... at every level down to the given depth.
+ * 
+ * @param struct corpus with the depth and fanout
+ * @param char *path as the directory to create the children of
+ * @param int level as the depth of path
+ * 
+ */
+
+void makeDirectories(struct corpus *corpus, char *path, int level)
+{
+    if (level >= corpus->depth)
+    {
+        return;
+    }
+
+    char *child = (char *)malloc(sizeof(char) * (strlen(path) + 16));
+
+    for (int d = 0; d < corpus->fanout; d++)
+    {
+        sprintf(child, "%s/d%d", path, d);
+
+        if (mkdir(child, 0755) != 0 && errno != EEXIST)
+        {
+            printf("Error: [%s] directory cannot be created, exiting\n", child);
+            exit(0);
+        }
+
+        makeDirectories(corpus, child, level + 1);
+    }
+
+    free(child);
+}
+
+/*
+ * makeCorpus() writes every file of the corpus.
+ * 
+ * Each file goes into a random directory of the tree, picked by walking down a random
+ * number of levels. Its length is drawn log-uniformly between minWords and maxWords. A
+ * similar file starts from the words of an earlier file and replaces a random 5 to 30
+ * percent of them, and every other file is drawn from the Zipfian distribution.
+ * 
+ * @param struct corpus to write
+ * 
+ */
+
+void makeCorpus(struct corpus *corpus)
+{
+    uint64_t state = corpus->seed;
+
+    makeVocabulary(corpus, &state);
+    makeDirectories(corpus, corpus->dir, 0);
+
+    // Keeping the word ranks of every file so that similar files can copy them
+
+    int **fileWords = (int **)malloc(sizeof(int *) * corpus->numFiles);
+    int *fileLengths = (int *)malloc(sizeof(int) * corpus->numFiles);
+    char *path = (char *)malloc(sizeof(char) * (strlen(corpus->dir) + 16 * (corpus->depth + 2)));
+    char *line = (char *)malloc(sizeof(char) * 4096);
+
+    for (int f = 0; f < corpus->numFiles; f++)
+    {
+        // Picking the length and the words of the file
+
+        double spread = log((double)corpus->maxWords / corpus->minWords);
+        int length = (int)(corpus->minWords * exp(uniform(&state) * spread));
+
+        if (length > corpus->maxWords)
+        {
+            length = corpus->maxWords;
+        }
+
+        if (f > 0 && uniform(&state) < corpus->similar)
+        {
+            int source = nextRandom(&state) % f;
+            double replaced = 0.05 + 0.25 * uniform(&state);
+
+            length = fileLengths[source];
+            fileWords[f] = (int *)malloc(sizeof(int) * length);
+
+            for (int w = 0; w < length; w++)
+            {
+                fileWords[f][w] = (uniform(&state) < replaced) ? zipfWord(corpus, &state) : fileWords[source][w];
+            }
+        }
+        else
+        {
+            fileWords[f] = (int *)malloc(sizeof(int) * length);
+
+            for (int w = 0; w < length; w++)
+            {
+                fileWords[f][w] = zipfWord(corpus, &state);
+            }
+        }
+
+        fileLengths[f] = length;
+
+        // Picking the directory of the file
+
+        int level = (corpus->depth == 0) ? 0 : nextRandom(&state) % (corpus->depth + 1);
+        int used = sprintf(path, "%s", corpus->dir);
+
+        for (int l = 0; l < level; l++)
+        {
+            used += sprintf(path + used, "/d%d", (int)(nextRandom(&state) % corpus->fanout));
+        }
+
+        sprintf(path + used, "/f%d.txt", f);
+
+        // Writing the words, a dozen to a line with the first letter of every line capitalized
+
+        FILE *out = fopen(path, "w");
+
+        if (out == NULL)
+        {
+            printf("Error: File [%s] cannot be written, exiting\n", path);
+            exit(0);
+        }
+
+        int lineLength = 0;
+
+        for (int w = 0; w < length; w++)
+        {
+            const char *word = corpus->words[fileWords[f][w]];
+            bool endOfLine = (w % 12 == 11 || w == length - 1);
+
+            lineLength += sprintf(line + lineLength, "%s%c", word, endOfLine ? '\n' : ' ');
+
+            if (w % 12 == 0)
+            {
+                line[lineLength - strlen(word) - 1] -= 'a' - 'A';
+            }
+
+            if (endOfLine)
+            {
+                fwrite(line, 1, lineLength, out);
+                corpus->totalBytes += lineLength;
+                lineLength = 0;
+            }
+        }
+
+        corpus->totalWords += length;
+        fclose(out);
+    }
+
+    for (int f = 0; f < corpus->numFiles; f++)
+    {
+        free(fileWords[f]);
+    }
+
+    free(fileWords);
+    free(fileLengths);
+    free(path);
+    free(line);
+}
+
+/*
+ * run() runs a command in a child process with its output sent to /dev/null, and
+ * measures it. Its error output goes to errorPath when there is one.
+ * 
+ * The wall time is taken around the whole child, and the CPU times and peak RSS come
+ * from the resource usage wait4() returns for the child.
+ * 
+ * @param char *const argv[] as the command, ending with NULL
+ * @param const char *errorPath as the file to write the error output to, or NULL
+ * 
+ * @return measurement of the run
+ * 
+ */
+
+struct measurement run(char *const argv[], const char *errorPath)
+{
+    struct measurement result;
+    struct timespec start;
+    struct timespec end;
+    struct rusage usage;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    pid_t pid = fork();
+
+    if (pid == 0)
+    {
+        int null = open("/dev/null", O_WRONLY);
+
+        dup2(null, STDOUT_FILENO);
+
+        if (errorPath != NULL)
+        {
+            int error = open(errorPath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+            dup2(error, STDERR_FILENO);
+        }
+
+        execvp(argv[0], argv);
+        _exit(127);
+    }
+
+    if (pid == -1 || wait4(pid, &result.status, 0, &usage) == -1)
+    {
+        printf("Error: [%s] cannot be run, exiting\n", argv[0]);
+        exit(0);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    result.wall = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    result.user = usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6;
+    result.sys = usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+    result.peakRSS = usage.ru_maxrss;
+
+    return result;
+}
+
+/*
+ * report() prints one CSV line for a measured run.
+ * 
+ * @param struct corpus with the size of the corpus
+ * @param const char *phase as the name of the phase
+ * @param int runIndex as the number of the run
+ * @param struct measurement *result to print
+ * 
+ */
+
+void report(struct corpus *corpus, const char *phase, int runIndex, struct measurement *result)
+{
+    int status = WIFEXITED(result->status) ? WEXITSTATUS(result->status) : -1;
+
+    printf("%d,%ld,%ld,%s,%d,%.6f,%.6f,%.6f,%ld,%d\n", corpus->numFiles, corpus->totalWords, corpus->totalBytes, phase, runIndex, result->wall, result->user, result->sys, result->peakRSS, status);
+    fflush(stdout);
+}
+
+/*
+ * reportStats() prints one CSV line for every phase in the --stats output of a run,
+ * which are the lines that look like stats,phase,<name>,<wall>,<user>,<system>,<RSS>.
+ * 
+ * @param struct corpus with the size of the corpus
+ * @param int runIndex as the number of the run
+ * @param struct measurement *result of the whole run, for its status
+ * @param const char *statsPath as the file the error output of the run went to
+ * 
+ */
+
+void reportStats(struct corpus *corpus, int runIndex, struct measurement *result, const char *statsPath)
+{
+    FILE *in = fopen(statsPath, "r");
+
+    if (in == NULL)
+    {
+        return;
+    }
+
+    char line[256];
+    char name[64];
+    struct measurement phase;
+
+    phase.status = result->status;
+
+    while (fgets(line, sizeof(line), in) != NULL)
+    {
+        if (sscanf(line, "stats,phase,%63[^,],%lf,%lf,%lf,%ld", name, &phase.wall, &phase.user, &phase.sys, &phase.peakRSS) == 5)
+        {
+            char label[80];
+
+            snprintf(label, sizeof(label), "full/%s", name);
+            report(corpus, label, runIndex, &phase);
+        }
+    }
+
+    fclose(in);
+}
+
+/*
+ * freeCorpus() frees the vocabulary and the directory name.
+ * 
+ * @param struct corpus to free
+ * 
+ */
+
+void freeCorpus(struct corpus *corpus)
+{
+    for (int w = 0; w < corpus->vocabSize; w++)
+    {
+        free(corpus->words[w]);
+    }
+
+    free(corpus->words);
+    free(corpus->cdf);
+    free(corpus->dir);
+}